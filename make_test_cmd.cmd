@@ -1 +1,5 @@
-cl /nologo /Od /EHs-c- /GS /GR- /fp:fast /Gs /RTCs /RTCu /nologo /W4 /WX /FC /D_CRT_SECURE_NO_WARNINGS /DBUILD_WINDOWS /Fevm.exe /Zi minvm_driver.c minvm_itr.c minvm_int.c minvm_test.c
+cl /nologo /Od /EHs-c- /GS /GR- /fp:fast /Gs /RTCs /RTCu /nologo /W4 /WX /FC /D_CRT_SECURE_NO_WARNINGS /DBUILD_WINDOWS /Zi /c minvm_test.c minvm_int.c minvm_itr.c minvm_context.c minvm_cfg.c minvm_verify.c minvm_thread.c minvm_multi.c minvm_memo.c minvm_sweep.c minvm_channel.c minvm_results.c minvm_cost.c minvm_batch.c
+lib /nologo /OUT:minvm.lib minvm_test.obj minvm_int.obj minvm_itr.obj minvm_context.obj minvm_cfg.obj minvm_verify.obj minvm_thread.obj minvm_multi.obj minvm_memo.obj minvm_sweep.obj minvm_channel.obj minvm_results.obj minvm_cost.obj minvm_batch.obj
+cl /nologo /Od /EHs-c- /GS /GR- /fp:fast /Gs /RTCs /RTCu /nologo /W4 /WX /FC /D_CRT_SECURE_NO_WARNINGS /DBUILD_WINDOWS /Zi /Fevm.exe minvm_driver.c minvm.lib
+cl /nologo /Od /EHs-c- /GS /GR- /fp:fast /Gs /RTCs /RTCu /nologo /W4 /WX /FC /D_CRT_SECURE_NO_WARNINGS /DBUILD_WINDOWS /Zi /Fevmopt.exe minvm_opt.c minvm.lib
+cl /nologo /Od /EHs-c- /GS /GR- /fp:fast /Gs /RTCs /RTCu /nologo /W4 /WX /FC /D_CRT_SECURE_NO_WARNINGS /DBUILD_WINDOWS /DMINVM_ADDRESS_BITS=16 /Zi /Fevm16.exe minvm_driver.c minvm_test.c minvm_int.c minvm_itr.c minvm_context.c minvm_cfg.c minvm_verify.c minvm_results.c minvm_thread.c minvm_cost.c minvm_batch.c
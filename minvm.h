@@ -0,0 +1,47 @@
+#ifndef _included_minvm_h
+#define _included_minvm_h
+
+//
+// libminvm
+//
+// Public header of the library build (libminvm.a and libminvm.so). Every
+// function that logs or allocates takes the mvm_context_t it reports to, and
+// the library keeps no mutable globals, so machines on separate contexts can
+// run on separate threads.
+//
+// The multi-core, memo, sweep and network modules are built for the classic
+// geometry only, see MINVM_ADDRESS_BITS in minvm_defs.h.
+//
+//   mvm_context_t context;
+//   virtual_machine_t vm;
+//
+//   mvm_context_init(&context);
+//   mvm_vm_init(&vm, &context, ram);
+//   vm_exec(&vm);
+//
+
+#include <stdio.h>
+#include <stdarg.h>
+
+#include "minvm_defs.h"
+#include "minvm_context.h"
+#include "minvm_int.h"
+#include "minvm_cfg.h"
+#include "minvm_verify.h"
+#include "minvm_results.h"
+#include "minvm_cost.h"
+#include "minvm_batch.h"
+#if MINVM_ADDRESS_BITS == 8
+#include "minvm_multi.h"
+#include "minvm_memo.h"
+#include "minvm_sweep.h"
+#include "minvm_channel.h"
+#endif
+
+void        vm_exec (virtual_machine_t *vm);
+void        vm_step (virtual_machine_t *vm);
+void        vm_exec_verified (virtual_machine_t *vm);
+uint64_t    vm_run (virtual_machine_t *vm, uint64_t budget);
+uint64_t    vm_run_verified (virtual_machine_t *vm, uint64_t budget);
+
+#endif // _included_minvm_h
@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "minvm_defs.h"
+#include "minvm_context.h"
+#include "minvm_int.h"
+#include "minvm_batch.h"
+
+typedef struct batch_job_t {
+    uint64_t    cost;
+    uint32_t    index;
+} batch_job_t;
+
+typedef struct batch_t {
+    batch_job_t         *order;         // Jobs by decreasing cost
+    uint32_t            count;
+    uint32_t            next;           // Next job in order to start
+    mvm_mutex_t         lock;           // Guards next
+    batch_function_t    function;
+    void                *user;
+} batch_t;
+
+// Most expensive first, ties in submission order
+static int mvm_batch_compare (const void *left, const void *right) {
+    const batch_job_t *l = (const batch_job_t*)left;
+    const batch_job_t *r = (const batch_job_t*)right;
+
+    if (l->cost != r->cost) {
+        return (l->cost > r->cost) ? -1 : 1;
+    }
+    return (l->index < r->index) ? -1 : (l->index > r->index);
+}
+
+static void mvm_batch_worker (void *arg) {
+    batch_t *batch = (batch_t*)arg;
+
+    for (;;) {
+        uint32_t next;
+
+        mvm_mutex_lock(&batch->lock);
+        next = batch->next;
+        if (next < batch->count) {
+            batch->next++;
+        }
+        mvm_mutex_unlock(&batch->lock);
+
+        if (next >= batch->count) {
+            break;
+        }
+
+        batch->function(batch->user, batch->order[next].index);
+    }
+}
+
+bool mvm_batch_run (mvm_context_t *context, const uint64_t *costs, uint32_t count,
+                    uint32_t threads, batch_function_t function, void *user) {
+    batch_t batch;
+    mvm_thread_t *workers;
+    uint32_t started;
+    uint32_t i;
+
+    if (threads == 0) {
+        threads = mvm_cpu_count();
+    }
+    if (threads > count) {
+        threads = count;
+    }
+    if (count == 0) {
+        return true;
+    }
+
+    memset(&batch, 0, sizeof(batch));
+    batch.count = count;
+    batch.function = function;
+    batch.user = user;
+    batch.order = (batch_job_t*)mvm_alloc(context, count * sizeof(batch_job_t));
+    workers = (mvm_thread_t*)mvm_alloc(context, threads * sizeof(mvm_thread_t));
+    if (!batch.order || !workers) {
+        mvm_error(context, "mvm_batch: couldn't allocate %u jobs", count);
+        mvm_free(context, batch.order);
+        mvm_free(context, workers);
+        return false;
+    }
+
+    for (i = 0; i < count; ++i) {
+        batch.order[i].cost = costs[i];
+        batch.order[i].index = i;
+    }
+    qsort(batch.order, count, sizeof(batch_job_t), mvm_batch_compare);
+
+    // The calling thread works too, so a batch on one thread starts none
+    mvm_mutex_init(&batch.lock);
+    for (started = 0; started + 1 < threads; ++started) {
+        if (!mvm_thread_start(&workers[started], mvm_batch_worker, &batch)) {
+            mvm_error(context, "mvm_batch: couldn't start thread %u", started);
+            break;
+        }
+    }
+
+    mvm_batch_worker(&batch);
+
+    for (i = 0; i < started; ++i) {
+        mvm_thread_join(&workers[i]);
+    }
+
+    mvm_mutex_destroy(&batch.lock);
+    mvm_free(context, batch.order);
+    mvm_free(context, workers);
+
+    return true;
+}
@@ -0,0 +1,21 @@
+#ifndef _included_minvm_batch_h
+#define _included_minvm_batch_h
+
+#include "minvm_thread.h"
+
+//
+// Longest job first batches
+//
+// Runs a batch of independent jobs on a pool of host threads. Jobs are
+// started in order of decreasing estimated cost, so one long job doesn't
+// start last and hold up the end of the batch. Each thread takes the next
+// job as soon as it finishes the previous one.
+//
+
+typedef void (*batch_function_t)(void *user, uint32_t job);
+
+// Calls function once per job, on up to threads threads or one per CPU when 0
+bool        mvm_batch_run (mvm_context_t *context, const uint64_t *costs, uint32_t count,
+                           uint32_t threads, batch_function_t function, void *user);
+
+#endif // _included_minvm_batch_h
@@ -0,0 +1,156 @@
+#include <string.h>
+
+#include "minvm_defs.h"
+#include "minvm_cfg.h"
+
+typedef struct opcode_info_t {
+    cchar       *name;
+    byte        code;
+    cchar       *args;
+    byte        size;
+} opcode_info_t;
+
+// The first 16 entries are the real opcodes, in encoding order
+static const opcode_info_t s_opcodes[] = {
+#define OPCODE(name, code, args, size) { #name, code, args, size },
+#include "minvm_opcodes.h"
+#undef OPCODE
+};
+
+static const byte s_bit_count[] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+
+cchar* mvm_opcode_name (byte opcode) {
+    return s_opcodes[opcode >> 4].name;
+}
+
+void mvm_decode (const byte *code, address_t pc, instruction_t *ins) {
+    byte word = code[pc];
+
+    ins->pc = pc;
+    ins->opcode = word & 0xF0;
+    ins->argument = word & 0x0F;
+    ins->size = s_opcodes[word >> 4].size;
+    ins->operand = (ins->size > 1) ? code[(address_t)(pc + 1)] : 0;
+
+    // LOADI carries one immediate word per register in the mask
+    if (ins->opcode == 0x00) {
+        ins->size = 1 + s_bit_count[ins->argument];
+        ins->operand = 0;
+    }
+
+#if ADDRESS_WORDS == 2
+    // Jump and STOR addresses take a second word, high half last, and LOADR a page word
+    if (ins->opcode >= 0xC0 && ins->opcode <= 0xE0) {
+        ins->operand |= (address_t)(code[(address_t)(pc + 2)] << WORD_SIZE);
+        ins->size++;
+    } else if (ins->opcode == 0x30) {
+        ins->size++;
+    }
+#endif
+}
+
+// True when the operand mask is invalid, so the instruction always raises an exception
+bool mvm_instruction_traps (const instruction_t *ins) {
+    byte required;
+
+    switch (ins->opcode) {
+        case 0x30: // LOADR
+            required = s_bit_count[ins->argument]; break;
+        case 0x40: case 0x50: case 0x60: case 0x70: // ADD, SUB, MUL, DIV
+        case 0x80: case 0x90: case 0xA0: // AND, OR, XOR
+            required = 2; break;
+        default:
+            return false;
+    }
+
+    return (ins->operand & 0xF0) || s_bit_count[ins->operand] != required;
+}
+
+// Registers an instruction reads and writes
+void mvm_register_uses (const instruction_t *ins, byte *reads, byte *writes) {
+    *reads = 0;
+    *writes = 0;
+
+    switch (ins->opcode) {
+        case 0x00: // LOADI
+            *writes = ins->argument; break;
+        case 0x10: case 0x20: case 0xB0: // INC, DEC, ROTR
+            *reads = ins->argument;
+            *writes = ins->argument; break;
+        case 0xC0: case 0xD0: case 0xE0: // JMPNEQ, JMPEQ, STOR
+            *reads = ins->argument; break;
+        case 0xF0: // ITR, the handler may read anything
+            *reads = REGA | REGB | REGC | REGD; break;
+        default: // LOADR, ADD, SUB, MUL, DIV, AND, OR, XOR
+            *reads = ins->operand & 0x0F;
+            *writes = ins->argument; break;
+    }
+}
+
+// Fills next with the possible addresses executed after the instruction, returns their count
+byte mvm_successors (const instruction_t *ins, address_t next[2]) {
+    address_t fallthrough = (address_t)(ins->pc + ins->size);
+
+    if (ins->opcode == 0x00 && ins->argument == 0) { // Halt
+        return 0;
+    }
+
+    if (mvm_instruction_traps(ins)) {
+        return 0;
+    }
+
+    if (ins->opcode == 0xC0 || ins->opcode == 0xD0) { // JMPNEQ, JMPEQ
+        if (ins->argument == 0) { // Unconditional
+            next[0] = ins->operand;
+            return 1;
+        }
+        next[0] = fallthrough;
+        next[1] = ins->operand;
+        return 2;
+    }
+
+    next[0] = fallthrough;
+    return 1;
+}
+
+void mvm_build_cfg (const byte *code, cfg_t *cfg) {
+    address_t pending[RAM_SIZE];
+    uint32_t top = 0;
+
+    memset(cfg, 0, sizeof(*cfg));
+
+    // Execution starts at the first word in memory
+    cfg->flags[0] |= CFG_ENTRY;
+    pending[top++] = 0;
+
+    while (top > 0) {
+        instruction_t ins;
+        address_t next[2];
+        byte count;
+        byte index;
+
+        mvm_decode(code, pending[--top], &ins);
+        cfg->count++;
+
+        for (index = 0; index < ins.size; ++index) {
+            cfg->flags[(address_t)(ins.pc + index)] |= CFG_CODE;
+        }
+
+        if (ins.opcode == 0xE0) { // STOR writes one word per register in the mask
+            for (index = 0; index < s_bit_count[ins.argument]; ++index) {
+                cfg->flags[(address_t)(ins.operand + index)] |= CFG_STORED;
+            }
+        }
+
+        count = mvm_successors(&ins, next);
+        for (index = 0; index < count; ++index) {
+            if ((ins.opcode == 0xC0 || ins.opcode == 0xD0) && next[index] == ins.operand) {
+                cfg->flags[next[index]] |= CFG_TARGET;
+            }
+            if (!(cfg->flags[next[index]] & CFG_ENTRY)) {
+                cfg->flags[next[index]] |= CFG_ENTRY;
+                pending[top++] = next[index];
+            }
+        }
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef _included_minvm_cfg_h
+#define _included_minvm_cfg_h
+
+//
+// Static decoding and control-flow analysis of a RAM image
+//
+
+// A single decoded instruction
+typedef struct instruction_t {
+    address_t   pc;             // Address of the instruction word
+    byte        opcode;         // The upper 4 bits of the instruction
+    byte        argument;       // The lower 4 bits of the instruction
+    address_t   operand;        // The mask or address following the instruction word
+    byte        size;           // Words used by the instruction and its operands
+} instruction_t;
+
+// Per-word flags in cfg_t
+#define CFG_ENTRY         0x01    // Word is the first word of a reachable instruction
+#define CFG_CODE          0x02    // Word is part of a reachable instruction or its operands
+#define CFG_TARGET        0x04    // Word is the destination of a reachable jump
+#define CFG_STORED        0x08    // Word may be written by a reachable STOR
+
+// Control-flow graph of the instructions reachable from the entry point
+typedef struct cfg_t {
+    byte        flags[RAM_SIZE];
+    uint32_t    count;          // Number of reachable instructions
+} cfg_t;
+
+cchar*      mvm_opcode_name (byte opcode);
+void        mvm_decode (const byte *code, address_t pc, instruction_t *ins);
+bool        mvm_instruction_traps (const instruction_t *ins);
+void        mvm_register_uses (const instruction_t *ins, byte *reads, byte *writes);
+byte        mvm_successors (const instruction_t *ins, address_t next[2]);
+void        mvm_build_cfg (const byte *code, cfg_t *cfg);
+
+#endif // _included_minvm_cfg_h
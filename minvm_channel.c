@@ -0,0 +1,639 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "minvm_defs.h"
+#include "minvm_context.h"
+#include "minvm_int.h"
+#include "minvm_verify.h"
+#include "minvm_channel.h"
+
+extern uint64_t vm_run(virtual_machine_t *vm, uint64_t budget);
+extern uint64_t vm_run_verified(virtual_machine_t *vm, uint64_t budget);
+
+#define NETWORK_LINE_SZ   512
+
+typedef struct network_scheduler_t network_scheduler_t;
+
+typedef struct network_worker_t {
+    mvm_network_t       *network;
+    network_scheduler_t *scheduler;
+    uint32_t            index;
+
+    // Runnable nodes, a ring of node indices that other workers steal from
+    mvm_mutex_t         lock;
+    uint32_t            *queue;
+    uint32_t            first;
+    uint32_t            length;
+} network_worker_t;
+
+struct network_scheduler_t {
+    network_worker_t    *workers;
+    uint32_t            jobs;
+    volatile uint32_t   pending;        // Nodes queued or running, none left ends the run
+
+    // Idle workers sleep on wake
+    mvm_mutex_t         lock;
+    mvm_cond_t          wake;
+    volatile uint32_t   sleeping;
+};
+
+//
+// Channels
+//
+
+static bool mvm_channel_send (mvm_channel_t *channel, byte value) {
+    uint32_t tail = channel->tail;
+
+    if (tail - channel->head_seen == CHANNEL_SIZE) {
+        channel->head_seen = mvm_atomic_load(&channel->head);
+        if (tail - channel->head_seen == CHANNEL_SIZE) {
+            return false;
+        }
+    }
+
+    channel->data[tail & (CHANNEL_SIZE - 1)] = value;
+    mvm_atomic_store(&channel->tail, tail + 1);
+    return true;
+}
+
+static bool mvm_channel_receive (mvm_channel_t *channel, byte *value) {
+    uint32_t head = channel->head;
+
+    if (head == channel->tail_seen) {
+        channel->tail_seen = mvm_atomic_load(&channel->tail);
+        if (head == channel->tail_seen) {
+            return false;
+        }
+    }
+
+    *value = channel->data[head & (CHANNEL_SIZE - 1)];
+    mvm_atomic_store(&channel->head, head + 1);
+    return true;
+}
+
+// Both counters are loaded atomically, another thread may already be running the parked node
+static bool mvm_channel_ready (mvm_channel_t *channel, bool sending) {
+    if (sending) {
+        return mvm_atomic_load(&channel->tail) - mvm_atomic_load(&channel->head) < CHANNEL_SIZE;
+    }
+    return mvm_atomic_load(&channel->tail) != mvm_atomic_load(&channel->head);
+}
+
+//
+// Interrupts
+//
+
+// Back on the ITR so it runs again, the halt flag returns control to the scheduler. The retried ITR
+// is counted when it runs, not now
+static void mvm_node_park (mvm_node_t *node, mvm_channel_t *channel, bool sending) {
+    node->vm.pc--;
+    node->vm.flags |= MINVM_HALT;
+    node->vm.instructions--;
+    node->blocked = channel;
+    node->sending = sending;
+}
+
+static void itr_send (virtual_machine_t *state) {
+    mvm_node_t *node = (mvm_node_t*)state;
+    mvm_channel_t *channel = (state->b < CHANNEL_PORTS) ? node->outputs[state->b] : NULL;
+
+    if (!channel) {
+        state->flags = MINVM_EXCEPTION | MINVM_HALT;
+    } else if (mvm_channel_send(channel, state->a)) {
+        node->messages++;
+        node->sent |= 1u << state->b;
+    } else {
+        mvm_node_park(node, channel, true);
+    }
+}
+
+static void itr_receive (virtual_machine_t *state) {
+    mvm_node_t *node = (mvm_node_t*)state;
+    mvm_channel_t *channel = (state->b < CHANNEL_PORTS) ? node->inputs[state->b] : NULL;
+
+    if (!channel) {
+        state->flags = MINVM_EXCEPTION | MINVM_HALT;
+    } else if (mvm_channel_receive(channel, &state->a)) {
+        node->received |= 1u << state->b;
+    } else {
+        mvm_node_park(node, channel, false);
+    }
+}
+
+//
+// Construction
+//
+
+void mvm_network_init (mvm_context_t *context, mvm_network_t *network) {
+    memset(network, 0, sizeof(*network));
+    network->context = context;
+    memcpy(network->interrupts, context->interrupts, sizeof(network->interrupts));
+    network->interrupts[ITR_SEND] = itr_send;
+    network->interrupts[ITR_RECEIVE] = itr_receive;
+}
+
+static mvm_node_t* mvm_network_find (mvm_network_t *network, cchar *name) {
+    uint32_t i;
+    for (i = 0; i < network->count; ++i) {
+        if (0 == strcmp(network->nodes[i].name, name)) {
+            return &network->nodes[i];
+        }
+    }
+    return NULL;
+}
+
+// Doubles an array of size bytes per element
+static void* mvm_network_grow (mvm_context_t *context, void *items, uint32_t count, uint32_t *capacity, size_t size) {
+    uint32_t grown = *capacity ? *capacity * 2 : 16;
+    void *next = mvm_alloc(context, grown * size);
+
+    if (!next) {
+        mvm_error(context, "mvm_network: couldn't allocate %u entries", grown);
+        return NULL;
+    }
+
+    if (items) {
+        memcpy(next, items, count * size);
+        mvm_free(context, items);
+    }
+    *capacity = grown;
+    return next;
+}
+
+bool mvm_network_add (mvm_network_t *network, cchar *name, const byte *image, uint32_t size) {
+    verify_report_t report;
+    mvm_node_t *node;
+
+    if (strlen(name) >= NODE_NAME_SZ || mvm_network_find(network, name)) {
+        mvm_error(network->context, "mvm_network: bad or duplicate name: %s", name);
+        return false;
+    }
+
+    if (size > RAM_SIZE) {
+        mvm_error(network->context, "mvm_network: %s: invalid RAM: %u", name, size);
+        return false;
+    }
+
+    if (network->count == network->capacity) {
+        mvm_node_t *nodes = (mvm_node_t*)mvm_network_grow(network->context, network->nodes,
+            network->count, &network->capacity, sizeof(mvm_node_t));
+        if (!nodes) {
+            return false;
+        }
+        network->nodes = nodes;
+    }
+
+    node = &network->nodes[network->count++];
+    memset(node, 0, sizeof(*node));
+    strcpy(node->name, name);
+    memcpy(node->ram, image, size);
+    node->verified = mvm_verify(node->ram, &report);
+    return true;
+}
+
+bool mvm_network_connect (mvm_network_t *network, cchar *from, uint32_t output, cchar *to, uint32_t input) {
+    mvm_node_t *producer = mvm_network_find(network, from);
+    mvm_node_t *consumer = mvm_network_find(network, to);
+    mvm_channel_t *channel;
+
+    if (!producer || !consumer) {
+        mvm_error(network->context, "mvm_network: unknown machine in %s.%u -> %s.%u", from, output, to, input);
+        return false;
+    }
+
+    if (output >= CHANNEL_PORTS || input >= CHANNEL_PORTS
+        || producer->outputs[output] || consumer->inputs[input]) {
+        mvm_error(network->context, "mvm_network: bad or reused port in %s.%u -> %s.%u", from, output, to, input);
+        return false;
+    }
+
+    if (network->channel_count == network->channel_capacity) {
+        mvm_channel_t **channels = (mvm_channel_t**)mvm_network_grow(network->context, network->channels,
+            network->channel_count, &network->channel_capacity, sizeof(mvm_channel_t*));
+        if (!channels) {
+            return false;
+        }
+        network->channels = channels;
+    }
+
+    channel = (mvm_channel_t*)mvm_alloc(network->context, sizeof(mvm_channel_t));
+    if (!channel) {
+        mvm_error(network->context, "mvm_network: couldn't allocate a channel");
+        return false;
+    }
+
+    network->channels[network->channel_count++] = channel;
+    channel->producer = (uint32_t)(producer - network->nodes);
+    channel->consumer = (uint32_t)(consumer - network->nodes);
+    producer->outputs[output] = channel;
+    consumer->inputs[input] = channel;
+    return true;
+}
+
+// Splits "name.port"
+static bool mvm_network_port (char *endpoint, uint32_t *port) {
+    char *dot = strrchr(endpoint, '.');
+    char *end;
+
+    if (!dot || dot == endpoint) {
+        return false;
+    }
+    *dot = 0;
+    *port = (uint32_t)strtoul(dot + 1, &end, 0);
+    return end != dot + 1 && *end == 0;
+}
+
+static bool mvm_network_statement (mvm_network_t *network, cchar *directory, char *line, uint32_t number) {
+    char *words[4];
+    uint32_t count = 0;
+    char *p = line;
+
+    while (*p && count < COUNTOF(words)) {
+        while (*p == ' ' || *p == '\t' || *p == '\r') {
+            *p++ = 0;
+        }
+        if (!*p || *p == '#') {
+            break;
+        }
+        words[count++] = p;
+        while (*p && *p != ' ' && *p != '\t' && *p != '\r') {
+            p++;
+        }
+    }
+    if (*p == '#') {
+        *p = 0;
+    }
+
+    if (count == 0) {
+        return true;
+    }
+
+    if (count == 3 && 0 == strcmp(words[0], "vm")) {
+        char path[NETWORK_LINE_SZ];
+        buffer_t buffer;
+        bool status;
+
+        if (words[2][0] == '/' || words[2][0] == '\\') {
+            mvm_print_string(path, sizeof(path), "%s", words[2]);
+        } else {
+            mvm_print_string(path, sizeof(path), "%s%s", directory, words[2]);
+        }
+
+        if (!mvm_read_buffer_ram(network->context, path, &buffer)) {
+            return false;
+        }
+        status = mvm_network_add(network, words[1], buffer.data, RAM_SIZE);
+        return mvm_free_buffer(network->context, &buffer) && status;
+    }
+
+    if (count == 3 && 0 == strcmp(words[0], "connect")) {
+        uint32_t output;
+        uint32_t input;
+
+        if (!mvm_network_port(words[1], &output) || !mvm_network_port(words[2], &input)) {
+            mvm_error(network->context, "mvm_network: line %u: expected <name>.<port>", number);
+            return false;
+        }
+        return mvm_network_connect(network, words[1], output, words[2], input);
+    }
+
+    mvm_error(network->context, "mvm_network: line %u: expected vm or connect", number);
+    return false;
+}
+
+bool mvm_network_load (mvm_network_t *network, cchar *filename) {
+    char directory[NETWORK_LINE_SZ];
+    char line[NETWORK_LINE_SZ];
+    cchar *slash;
+    buffer_t buffer;
+    size_t start;
+    size_t i;
+    uint32_t number = 1;
+    bool status = true;
+
+    // Programs are found relative to the wiring file
+    slash = strrchr(filename, '/');
+    if (!slash) {
+        slash = strrchr(filename, '\\');
+    }
+    mvm_print_string(directory, sizeof(directory), "%.*s", slash ? (int)(slash - filename + 1) : 0, filename);
+
+    if (!mvm_read_buffer(network->context, filename, &buffer)) {
+        return false;
+    }
+
+    for (start = 0; status && start < buffer.data_size; start = i + 1, ++number) {
+        for (i = start; i < buffer.data_size && buffer.data[i] != '\n'; ++i) {
+        }
+        if (i - start >= sizeof(line)) {
+            mvm_error(network->context, "mvm_network: line %u is too long", number);
+            status = false;
+            break;
+        }
+        memcpy(line, buffer.data + start, i - start);
+        line[i - start] = 0;
+        status = mvm_network_statement(network, directory, line, number);
+    }
+
+    return mvm_free_buffer(network->context, &buffer) && status;
+}
+
+void mvm_network_free (mvm_network_t *network) {
+    uint32_t i;
+
+    for (i = 0; i < network->channel_count; ++i) {
+        mvm_free(network->context, network->channels[i]);
+    }
+    mvm_free(network->context, network->channels);
+    mvm_free(network->context, network->nodes);
+    network->channels = NULL;
+    network->nodes = NULL;
+    network->count = 0;
+    network->channel_count = 0;
+}
+
+//
+// Scheduling
+//
+
+// Queues a runnable node on the worker and wakes a sleeping worker to steal it
+static void network_push (network_worker_t *worker, uint32_t index) {
+    network_scheduler_t *scheduler = worker->scheduler;
+    uint32_t capacity = worker->network->count;
+
+    mvm_mutex_lock(&worker->lock);
+    worker->queue[(worker->first + worker->length) % capacity] = index;
+    worker->length++;
+    mvm_mutex_unlock(&worker->lock);
+
+    // A worker that is just going to sleep can miss this, the node still runs here
+    if (mvm_atomic_load(&scheduler->sleeping)) {
+        mvm_mutex_lock(&scheduler->lock);
+        mvm_cond_signal(&scheduler->wake);
+        mvm_mutex_unlock(&scheduler->lock);
+    }
+}
+
+// Takes the oldest node of the worker's queue, or the newest when stealing from another worker
+static bool network_take (network_worker_t *worker, bool steal, uint32_t *index) {
+    uint32_t capacity = worker->network->count;
+    bool found = false;
+
+    mvm_mutex_lock(&worker->lock);
+    if (worker->length > 0) {
+        worker->length--;
+        if (steal) {
+            *index = worker->queue[(worker->first + worker->length) % capacity];
+        } else {
+            *index = worker->queue[worker->first];
+            worker->first = (worker->first + 1) % capacity;
+        }
+        found = true;
+    }
+    mvm_mutex_unlock(&worker->lock);
+    return found;
+}
+
+static bool network_find_work (network_worker_t *worker, uint32_t *index) {
+    network_scheduler_t *scheduler = worker->scheduler;
+    uint32_t i;
+
+    if (network_take(worker, false, index)) {
+        return true;
+    }
+    for (i = 1; i < scheduler->jobs; ++i) {
+        if (network_take(&scheduler->workers[(worker->index + i) % scheduler->jobs], true, index)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// A node that used up its slice goes behind the worker's other nodes, or keeps running when there are none
+static uint32_t network_rotate (network_worker_t *worker, uint32_t index) {
+    uint32_t next = index;
+    bool queued;
+
+    mvm_mutex_lock(&worker->lock);
+    queued = worker->length > 0;
+    mvm_mutex_unlock(&worker->lock);
+
+    if (queued) {
+        network_push(worker, index);
+        if (!network_take(worker, false, &next)) {
+            next = index;
+        }
+    }
+    return next;
+}
+
+static void network_stop (network_scheduler_t *scheduler, mvm_network_t *network) {
+    mvm_mutex_lock(&scheduler->lock);
+    mvm_atomic_store(&network->stop, 1);
+    mvm_cond_broadcast(&scheduler->wake);
+    mvm_mutex_unlock(&scheduler->lock);
+}
+
+// A node stopped being runnable. Only a running node can wake another, so once none is queued or
+// running, every node has halted or is blocked for good
+static void network_retire (network_worker_t *worker) {
+    if (mvm_atomic_add(&worker->scheduler->pending, (uint32_t)-1) == 0) {
+        network_stop(worker->scheduler, worker->network);
+    }
+}
+
+// Makes the node parked on the given end of the channel runnable
+static void network_unpark (network_worker_t *worker, mvm_channel_t *channel, uint32_t end) {
+    volatile uint32_t *parked = &channel->parked[end];
+
+    if (mvm_atomic_load(parked) && mvm_atomic_compare_exchange(parked, 1, 0)) {
+        mvm_atomic_add(&worker->scheduler->pending, 1);
+        network_push(worker, (end == CHANNEL_CONSUMER) ? channel->consumer : channel->producer);
+    }
+}
+
+// Wakes the nodes parked on the other ends of the channels the node used during its slice. The
+// fence pairs with the one in mvm_network_park: either the parking worker sees the transfers or
+// this sees its parked flag
+static void network_wake (network_worker_t *worker, mvm_node_t *node) {
+    uint32_t port;
+
+    if (!(node->sent | node->received)) {
+        return;
+    }
+
+    mvm_atomic_fence();
+    for (port = 0; port < CHANNEL_PORTS; ++port) {
+        if (node->sent & (1u << port)) {
+            network_unpark(worker, node->outputs[port], CHANNEL_CONSUMER);
+        }
+        if (node->received & (1u << port)) {
+            network_unpark(worker, node->inputs[port], CHANNEL_PRODUCER);
+        }
+    }
+    node->sent = 0;
+    node->received = 0;
+}
+
+// Publishes the node as parked on its channel. The node is taken back when the channel became ready
+// meanwhile and no other worker woke it first. Past the parked flag the node may already run on
+// another worker, so everything is read before. Each end has its own flag, the node on the other
+// end may park at the same time
+static bool mvm_network_park (mvm_node_t *node) {
+    mvm_channel_t *channel = node->blocked;
+    bool sending = node->sending;
+    volatile uint32_t *parked = &channel->parked[sending ? CHANNEL_PRODUCER : CHANNEL_CONSUMER];
+
+    node->vm.flags &= ~MINVM_HALT;
+    mvm_atomic_store(parked, 1);
+    mvm_atomic_fence();
+    return !(mvm_channel_ready(channel, sending) && mvm_atomic_compare_exchange(parked, 1, 0));
+}
+
+// Sleeps until a node can be stolen or the run is over
+static bool network_sleep (network_worker_t *worker, uint32_t *index) {
+    network_scheduler_t *scheduler = worker->scheduler;
+    bool found = false;
+
+    mvm_mutex_lock(&scheduler->lock);
+    while (!mvm_atomic_load(&worker->network->stop)) {
+        found = network_find_work(worker, index);
+        if (found) {
+            break;
+        }
+        mvm_atomic_store(&scheduler->sleeping, scheduler->sleeping + 1);
+        mvm_cond_wait(&scheduler->wake, &scheduler->lock);
+        mvm_atomic_store(&scheduler->sleeping, scheduler->sleeping - 1);
+    }
+    mvm_mutex_unlock(&scheduler->lock);
+    return found;
+}
+
+// Runs nodes a slice at a time until none is runnable
+static void mvm_network_worker (void *arg) {
+    network_worker_t *worker = (network_worker_t*)arg;
+    mvm_network_t *network = worker->network;
+    uint32_t index;
+
+    while (network_find_work(worker, &index) || network_sleep(worker, &index)) {
+        mvm_node_t *node = &network->nodes[index];
+
+        for (;;) {
+            node->blocked = NULL; // A parked node repeats its ITR
+            if (node->verified) {
+                node->vm.instructions += vm_run_verified(&node->vm, NODE_SLICE);
+            } else {
+                node->vm.instructions += vm_run(&node->vm, NODE_SLICE);
+            }
+            network_wake(worker, node);
+
+            if (node->vm.flags & MINVM_HALT) {
+                break;
+            }
+            if (mvm_atomic_load(&network->stop)) {
+                return;
+            }
+            index = network_rotate(worker, index);
+            node = &network->nodes[index];
+        }
+
+        if (node->blocked && !mvm_network_park(node)) {
+            network_push(worker, index);
+        } else {
+            network_retire(worker);
+        }
+    }
+}
+
+bool mvm_network_run (mvm_network_t *network, uint32_t jobs) {
+    network_scheduler_t scheduler;
+    network_worker_t *workers;
+    mvm_thread_t *threads;
+    uint32_t *queues;
+    uint32_t started;
+    uint32_t i;
+
+    if (jobs == 0) {
+        jobs = mvm_cpu_count();
+    }
+    if (jobs > network->count) {
+        jobs = network->count ? network->count : 1;
+    }
+
+    // The node array is final, so the machines can point into it now
+    for (i = 0; i < network->count; ++i) {
+        mvm_node_t *node = &network->nodes[i];
+        mvm_vm_init(&node->vm, network->context, node->ram);
+        node->vm.interrupts = network->interrupts;
+        node->blocked = NULL;
+        node->messages = 0;
+        node->sent = 0;
+        node->received = 0;
+    }
+    for (i = 0; i < network->channel_count; ++i) {
+        network->channels[i]->parked[CHANNEL_CONSUMER] = 0;
+        network->channels[i]->parked[CHANNEL_PRODUCER] = 0;
+    }
+    network->stop = (network->count == 0);
+
+    workers = (network_worker_t*)mvm_alloc(network->context, jobs * sizeof(network_worker_t));
+    threads = (mvm_thread_t*)mvm_alloc(network->context, jobs * sizeof(mvm_thread_t));
+    queues = (uint32_t*)mvm_alloc(network->context, jobs * (network->count + 1) * sizeof(uint32_t));
+    if (!workers || !threads || !queues) {
+        mvm_error(network->context, "mvm_network: couldn't allocate %u workers", jobs);
+        mvm_free(network->context, workers);
+        mvm_free(network->context, threads);
+        mvm_free(network->context, queues);
+        return false;
+    }
+
+    memset(&scheduler, 0, sizeof(scheduler));
+    scheduler.workers = workers;
+    scheduler.jobs = jobs;
+    scheduler.pending = network->count;
+    mvm_mutex_init(&scheduler.lock);
+    mvm_cond_init(&scheduler.wake);
+
+    // Every queue can hold every node, the nodes start spread evenly
+    for (i = 0; i < jobs; ++i) {
+        memset(&workers[i], 0, sizeof(workers[i]));
+        workers[i].network = network;
+        workers[i].scheduler = &scheduler;
+        workers[i].index = i;
+        workers[i].queue = queues + i * (network->count + 1);
+        mvm_mutex_init(&workers[i].lock);
+    }
+    for (i = 0; i < network->count; ++i) {
+        network_worker_t *worker = &workers[i % jobs];
+        worker->queue[worker->length++] = i;
+    }
+
+    // Worker 0 runs on the calling thread
+    for (started = 1; started < jobs; ++started) {
+        if (!mvm_thread_start(&threads[started], mvm_network_worker, &workers[started])) {
+            mvm_error(network->context, "mvm_network: couldn't start thread %u", started);
+            network_stop(&scheduler, network);
+            break;
+        }
+    }
+
+    if (started == jobs) {
+        mvm_network_worker(&workers[0]);
+    }
+
+    for (i = 1; i < started; ++i) {
+        mvm_thread_join(&threads[i]);
+    }
+
+    for (i = 0; i < jobs; ++i) {
+        mvm_mutex_destroy(&workers[i].lock);
+    }
+    mvm_cond_destroy(&scheduler.wake);
+    mvm_mutex_destroy(&scheduler.lock);
+    mvm_free(network->context, workers);
+    mvm_free(network->context, threads);
+    mvm_free(network->context, queues);
+    return started == jobs;
+}
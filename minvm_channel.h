@@ -0,0 +1,97 @@
+#ifndef _included_minvm_channel_h
+#define _included_minvm_channel_h
+
+#include "minvm_thread.h"
+
+//
+// Channels between machines
+//
+// A network is a set of named machines, each with its own RAM, whose ports
+// are wired together by single-producer single-consumer ring buffers. An
+// output port feeds exactly one input port. Machines send and receive one
+// byte at a time through interrupts:
+//
+//   ITR 4   send A on output port B, blocks while the channel is full
+//   ITR 5   receive A from input port B, blocks while the channel is empty
+//
+// Using a port that isn't wired, or a port number of CHANNEL_PORTS or more,
+// halts the machine with an exception.
+//
+// A blocked machine is parked with its program counter back on the ITR, so
+// it repeats the interrupt once the channel is ready; the retried ITR is
+// counted once. Each host thread keeps a queue of runnable machines and runs
+// them NODE_SLICE instructions at a time, then moves on to the next one. A
+// thread with an empty queue steals from the others, and sleeps on a
+// condition variable when there is nothing to steal. Parked machines cost
+// nothing: when a slice ends, the machines parked on the other ends of the
+// channels it used are made runnable again. The run is over once no machine
+// is runnable; the ones still parked are blocked for good.
+//
+// Wiring description, one statement per line, # starts a comment:
+//
+//   vm <name> <program.bin>              program path relative to the file
+//   connect <name>.<port> <name>.<port>  output port to input port
+//
+
+#define ITR_SEND          4
+#define ITR_RECEIVE       5
+
+#define CHANNEL_PORTS     16
+#define CHANNEL_SIZE      64      // Bytes buffered per channel, a power of two
+#define CHANNEL_CONSUMER  0
+#define CHANNEL_PRODUCER  1
+#define NODE_NAME_SZ      32
+#define NODE_SLICE        4096    // Instructions a machine runs before the thread moves on
+
+typedef struct mvm_channel_t {
+    // Producer side
+    volatile uint32_t   tail;           // Count of bytes sent
+    uint32_t            head_seen;      // Last head read by the producer
+    byte                producer_pad[56];
+
+    // Consumer side, on another cache line
+    volatile uint32_t   head;           // Count of bytes received
+    uint32_t            tail_seen;      // Last tail read by the consumer
+    byte                consumer_pad[56];
+
+    byte                data[CHANNEL_SIZE];
+
+    uint32_t            producer;       // Node indices
+    uint32_t            consumer;
+    volatile uint32_t   parked[2];      // Set while the node on the CHANNEL_ end is parked on it
+} mvm_channel_t;
+
+typedef struct mvm_node_t {
+    virtual_machine_t   vm;             // First member, interrupts receive a pointer to it
+    char                name[NODE_NAME_SZ];
+    byte                ram[RAM_SIZE];
+    bool                verified;       // Runs without operand checks
+    mvm_channel_t       *inputs[CHANNEL_PORTS];
+    mvm_channel_t       *outputs[CHANNEL_PORTS];
+    mvm_channel_t       *blocked;       // Channel the node is parked on, NULL when runnable
+    bool                sending;        // Parked waiting for space rather than data
+    uint64_t            messages;       // Bytes sent
+    uint32_t            sent;           // Port bits used during the current slice, the nodes on
+    uint32_t            received;       // their other ends are woken once it ends
+} mvm_node_t;
+
+typedef struct mvm_network_t {
+    mvm_context_t       *context;
+    mvm_node_t          *nodes;
+    uint32_t            count;
+    uint32_t            capacity;
+    mvm_channel_t       **channels;
+    uint32_t            channel_count;
+    uint32_t            channel_capacity;
+    interrupt_function_t interrupts[16];
+    volatile uint32_t   stop;           // Set once no node is runnable
+} mvm_network_t;
+
+void        mvm_network_init (mvm_context_t *context, mvm_network_t *network);
+bool        mvm_network_add (mvm_network_t *network, cchar *name, const byte *image, uint32_t size);
+bool        mvm_network_connect (mvm_network_t *network, cchar *from, uint32_t output, cchar *to, uint32_t input);
+bool        mvm_network_load (mvm_network_t *network, cchar *filename);
+bool        mvm_network_run (mvm_network_t *network, uint32_t jobs);
+void        mvm_network_free (mvm_network_t *network);
+
+#endif // _included_minvm_channel_h
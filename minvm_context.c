@@ -0,0 +1,67 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "minvm_defs.h"
+#include "minvm_context.h"
+
+// Messages go to stdout and errors to stderr, both flushed per line
+static void mvm_stdio_sink (void *user, mvm_stream_t stream, cchar *text, size_t size) {
+    FILE *file = (stream == MVM_ERROR) ? stderr : stdout;
+    UNREF(user);
+
+    fwrite(text, 1, size, file);
+    if (stream != MVM_OUTPUT) {
+        fflush(file);
+    }
+}
+
+static void* mvm_stdlib_alloc (void *user, size_t size) {
+    UNREF(user);
+    return malloc(size);
+}
+
+static void mvm_stdlib_free (void *user, void *ptr) {
+    UNREF(user);
+    free(ptr);
+}
+
+void mvm_context_init (mvm_context_t *context) {
+    uint32_t i;
+
+    memset(context, 0, sizeof(*context));
+    context->sink = mvm_stdio_sink;
+    context->alloc = mvm_stdlib_alloc;
+    context->free = mvm_stdlib_free;
+    context->interrupts[0] = mvm_itr_dump_state;
+    context->interrupts[1] = mvm_itr_print_a;
+    for (i = 2; i < COUNTOF(context->interrupts); ++i) {
+        context->interrupts[i] = mvm_itr_unassigned;
+    }
+}
+
+void mvm_vm_init (virtual_machine_t *vm, mvm_context_t *context, byte *code) {
+    memset(vm, 0, sizeof(*vm));
+    vm->interrupts = context->interrupts;
+    vm->code = code;
+    vm->context = context;
+}
+
+void mvm_write (mvm_context_t *context, mvm_stream_t stream, cchar *text, size_t size) {
+    context->sink(context->sink_user, stream, text, size);
+}
+
+// Returns zeroed memory
+void* mvm_alloc (mvm_context_t *context, size_t size) {
+    void *ptr = context->alloc(context->alloc_user, size);
+    if (ptr) {
+        memset(ptr, 0, size);
+    }
+    return ptr;
+}
+
+void mvm_free (mvm_context_t *context, void *ptr) {
+    if (ptr) {
+        context->free(context->alloc_user, ptr);
+    }
+}
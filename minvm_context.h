@@ -0,0 +1,47 @@
+#ifndef _included_minvm_context_h
+#define _included_minvm_context_h
+
+#include <stddef.h>
+
+//
+// Library context
+//
+// Owns the state the library would otherwise keep in globals: the error
+// count, the sink that receives messages and interrupt output, the default
+// interrupt table and the allocator. Contexts don't share anything, so each
+// thread can run machines on its own context without locking.
+//
+// A context is not locked itself. Multi-core and sweep runs call the sink and
+// the allocator from several host threads, so a context used for those needs
+// a thread safe sink and allocator; the defaults are.
+//
+
+#define MVM_LINE_SZ       8192    // Longer messages are truncated
+
+typedef enum mvm_stream_t {
+    MVM_OUTPUT,                   // Interrupt output of the guest program
+    MVM_INFO,                     // Messages, one line each
+    MVM_ERROR                     // Errors, one line each
+} mvm_stream_t;
+
+typedef void  (*mvm_sink_function_t)(void *user, mvm_stream_t stream, cchar *text, size_t size);
+typedef void* (*mvm_alloc_function_t)(void *user, size_t size);
+typedef void  (*mvm_free_function_t)(void *user, void *ptr);
+
+struct mvm_context_t {
+    uint32_t                errors;         // Number of mvm_error calls, counted atomically
+    mvm_sink_function_t     sink;
+    void                    *sink_user;
+    mvm_alloc_function_t    alloc;
+    mvm_free_function_t     free;
+    void                    *alloc_user;
+    interrupt_function_t    interrupts[16]; // Installed by mvm_vm_init
+};
+
+void        mvm_context_init (mvm_context_t *context);
+void        mvm_vm_init (virtual_machine_t *vm, mvm_context_t *context, byte *code);
+void        mvm_write (mvm_context_t *context, mvm_stream_t stream, cchar *text, size_t size);
+void*       mvm_alloc (mvm_context_t *context, size_t size);
+void        mvm_free (mvm_context_t *context, void *ptr);
+
+#endif // _included_minvm_context_h
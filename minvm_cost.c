@@ -0,0 +1,434 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "minvm_defs.h"
+#include "minvm_context.h"
+#include "minvm_int.h"
+#include "minvm_cost.h"
+#include "minvm_results.h"
+
+#define COST_LOOPS            256                     // Further loops are counted but not weighted
+#define COST_SATURATED        ((uint64_t)1 << 62)
+#define COST_MAX_WORDS        (1 + NUM_REGISTERS)     // LOADI of every register
+
+typedef struct cost_loop_t {
+    address_t   head;           // Target of the backward jump
+    address_t   tail;           // The backward jump
+    uint32_t    trips;
+} cost_loop_t;
+
+static const byte s_masks[] = { REGA, REGB, REGC, REGD };
+
+// Immediate a LOADI writes to a single register
+static byte mvm_cost_immediate (const byte *code, const instruction_t *ins, byte reg) {
+    address_t at = (address_t)(ins->pc + 1);
+    uint32_t i;
+
+    for (i = 0; i < NUM_REGISTERS && s_masks[i] != reg; ++i) {
+        if (ins->argument & s_masks[i]) {
+            at++;
+        }
+    }
+
+    return code[at];
+}
+
+// Counts the reachable instructions control can arrive at the word from, stopping at two, and
+// returns the first in from. Words that aren't jump targets can only be reached from the instruction
+// just before them, so only targets are searched in full. The entry point counts as one for
+// address 0, and the loop's own jumps back to its head are left out
+static uint32_t mvm_cost_predecessors (const byte *code, const cfg_t *cfg, const cost_loop_t *loop, address_t at, address_t *from) {
+    uint32_t count = (at == 0) ? 1 : 0;
+    uint32_t last = (cfg->flags[at] & CFG_TARGET) ? RAM_SIZE : COST_MAX_WORDS;
+    uint32_t k;
+
+    for (k = 1; k <= last && count < 2; ++k) {
+        address_t pc = (address_t)(at - k);
+        instruction_t ins;
+        address_t next[2];
+        byte successors;
+        byte i;
+
+        if (!(cfg->flags[pc] & CFG_ENTRY) || (at == loop->head && pc >= loop->head && pc <= loop->tail)) {
+            continue;
+        }
+
+        mvm_decode(code, pc, &ins);
+        successors = mvm_successors(&ins, next);
+        for (i = 0; i < successors; ++i) {
+            if (next[i] == at) {
+                if (count++ == 0) {
+                    *from = pc;
+                }
+                break;
+            }
+        }
+    }
+
+    return count;
+}
+
+// Value of a register on entry to the loop. Walks back from the head along the chain of unique
+// predecessors to the instruction that writes the register, false unless that is a LOADI. Reaching
+// the entry point first gives zero. A word control can reach from two places gives false, the
+// register could differ between them, and so does a chain that never ends
+static bool mvm_cost_initial (const byte *code, const cfg_t *cfg, const cost_loop_t *loop, byte reg, byte *value) {
+    address_t at = loop->head;
+    uint32_t steps;
+
+    *value = 0;
+    for (steps = 0; steps < RAM_SIZE; ++steps) {
+        instruction_t ins;
+        address_t from;
+        byte reads;
+        byte writes;
+
+        if (mvm_cost_predecessors(code, cfg, loop, at, &from) != 1) {
+            return false;
+        }
+        if (at == 0) { // The one way in is the entry point
+            return true;
+        }
+
+        mvm_decode(code, from, &ins);
+        mvm_register_uses(&ins, &reads, &writes);
+        if (writes & reg) {
+            if (ins.opcode != 0x00) { // LOADI
+                return false;
+            }
+            *value = mvm_cost_immediate(code, &ins, reg);
+            return true;
+        }
+        at = from;
+    }
+
+    return false;
+}
+
+// Number of instructions in the loop that write a register. When there is exactly one and it
+// is an INC or DEC of that register alone, step is +1 or -1, otherwise 0
+static uint32_t mvm_cost_writes (const byte *code, const cfg_t *cfg, const cost_loop_t *loop, byte reg, int *step) {
+    uint32_t count = 0;
+    uint32_t pc;
+
+    *step = 0;
+    for (pc = loop->head; pc <= loop->tail; ++pc) {
+        instruction_t ins;
+        byte reads;
+        byte writes;
+
+        if (!(cfg->flags[pc] & CFG_ENTRY)) {
+            continue;
+        }
+
+        mvm_decode(code, (address_t)pc, &ins);
+        mvm_register_uses(&ins, &reads, &writes);
+        if (!(writes & reg)) {
+            continue;
+        }
+
+        if (count++ == 0 && ins.argument == reg && (ins.opcode == 0x10 || ins.opcode == 0x20)) { // INC, DEC
+            *step = (ins.opcode == 0x10) ? 1 : -1;
+        } else {
+            *step = 0;
+        }
+    }
+
+    return count;
+}
+
+// Registers the loop test compares, the loop runs while they differ. 0 for any other test
+static byte mvm_cost_test (const byte *code, const cfg_t *cfg, const cost_loop_t *loop, const instruction_t *back) {
+    uint32_t pc;
+
+    if (back->argument != 0) { // A conditional JMPNEQ loops while its registers differ
+        return (back->opcode == 0xC0) ? back->argument : 0;
+    }
+
+    for (pc = loop->head; pc < loop->tail; ++pc) {
+        instruction_t ins;
+
+        if (!(cfg->flags[pc] & CFG_ENTRY)) {
+            continue;
+        }
+
+        mvm_decode(code, (address_t)pc, &ins);
+        if ((ins.opcode == 0xC0 || ins.opcode == 0xD0) && ins.argument != 0
+            && (ins.operand < loop->head || ins.operand > loop->tail)) {
+            return (ins.opcode == 0xD0) ? ins.argument : 0; // A JMPEQ leaves once they're equal
+        }
+    }
+
+    return 0;
+}
+
+// Trip count of a loop counting one register towards zero or another register, 0 when unknown
+static uint32_t mvm_cost_trips (const byte *code, const cfg_t *cfg, const cost_loop_t *loop, const instruction_t *back) {
+    byte mask = mvm_cost_test(code, cfg, loop, back);
+    byte induction = 0;
+    byte bound = 0;
+    byte start;
+    byte end = 0;
+    int step = 0;
+    uint32_t i;
+
+    if (mask == 0 || mvm_count_bits(mask) > 2) {
+        return 0;
+    }
+
+    for (i = 0; i < NUM_REGISTERS; ++i) {
+        int s;
+        if (!(mask & s_masks[i])) {
+            continue;
+        }
+        if (0 == mvm_cost_writes(code, cfg, loop, s_masks[i], &s)) {
+            if (bound) {
+                return 0;
+            }
+            bound = s_masks[i];
+        } else if (s == 0 || induction) {
+            return 0;
+        } else {
+            induction = s_masks[i];
+            step = s;
+        }
+    }
+
+    if (!induction || !mvm_cost_initial(code, cfg, loop, induction, &start)) {
+        return 0;
+    }
+    if (bound && !mvm_cost_initial(code, cfg, loop, bound, &end)) {
+        return 0;
+    }
+
+    // A distance of zero wraps all the way around
+    i = (byte)((step > 0) ? end - start : start - end);
+    return i ? i : 256;
+}
+
+void mvm_estimate_cost (const byte *code, cost_estimate_t *estimate) {
+    cfg_t cfg;
+    cost_loop_t loops[COST_LOOPS];
+    uint32_t count = 0;
+    uint32_t pc;
+    uint32_t i;
+
+    memset(estimate, 0, sizeof(*estimate));
+    mvm_build_cfg(code, &cfg);
+
+    for (pc = 0; pc < RAM_SIZE; ++pc) {
+        instruction_t ins;
+        cost_loop_t loop;
+
+        if (!(cfg.flags[pc] & CFG_ENTRY)) {
+            continue;
+        }
+
+        mvm_decode(code, (address_t)pc, &ins);
+        if ((ins.opcode != 0xC0 && ins.opcode != 0xD0) || ins.operand > pc) { // JMPNEQ, JMPEQ backwards
+            continue;
+        }
+
+        estimate->loops++;
+        loop.head = ins.operand;
+        loop.tail = (address_t)pc;
+        loop.trips = mvm_cost_trips(code, &cfg, &loop, &ins);
+        if (loop.trips == 0) {
+            loop.trips = COST_GUESSED_TRIPS;
+            estimate->guessed++;
+        }
+        if (count < COST_LOOPS) {
+            loops[count++] = loop;
+        }
+    }
+
+    for (pc = 0; pc < RAM_SIZE; ++pc) {
+        uint64_t weight = 1;
+
+        if (!(cfg.flags[pc] & CFG_ENTRY)) {
+            continue;
+        }
+
+        for (i = 0; i < count; ++i) {
+            if (pc >= loops[i].head && pc <= loops[i].tail) {
+                weight = (weight > COST_SATURATED / loops[i].trips) ? COST_SATURATED : weight * loops[i].trips;
+            }
+        }
+
+        estimate->instructions += weight;
+        if (estimate->instructions > COST_SATURATED) {
+            estimate->instructions = COST_SATURATED;
+        }
+    }
+}
+
+void mvm_history_init (mvm_context_t *context, cost_history_t *history) {
+    memset(history, 0, sizeof(*history));
+    history->context = context;
+}
+
+static int mvm_history_compare (const void *left, const void *right) {
+    const cost_history_entry_t *l = (const cost_history_entry_t*)left;
+    const cost_history_entry_t *r = (const cost_history_entry_t*)right;
+    int order = strcmp(l->name, r->name);
+
+    if (order != 0) {
+        return order;
+    }
+    return (l->order < r->order) ? -1 : (l->order > r->order);
+}
+
+static int mvm_history_compare_name (const void *key, const void *entry) {
+    return strcmp((cchar*)key, ((const cost_history_entry_t*)entry)->name);
+}
+
+// Copies the JSON string starting after its opening quote, undoing the escapes mvm_results_write makes
+static char* mvm_history_string (mvm_context_t *context, cchar *p) {
+    char *name = (char*)mvm_alloc(context, strlen(p) + 1);
+    size_t size = 0;
+
+    if (!name) {
+        return NULL;
+    }
+
+    for (; *p && *p != '"'; ++p) {
+        if (*p != '\\' || !p[1]) {
+            name[size++] = *p;
+        } else if (p[1] == 'u' && mvm_ishex(p[2]) && mvm_ishex(p[3]) && mvm_ishex(p[4]) && mvm_ishex(p[5])) {
+            char hex[5];
+            memcpy(hex, p + 2, 4);
+            hex[4] = '\0';
+            name[size++] = (char)strtoul(hex, NULL, 16);
+            p += 5;
+        } else {
+            name[size++] = *++p;
+        }
+    }
+    name[size] = '\0';
+
+    return name;
+}
+
+static bool mvm_history_add (cost_history_t *history, char *name, uint64_t instructions) {
+    cost_history_entry_t *entry;
+
+    if (history->count == history->capacity) {
+        uint32_t capacity = history->capacity ? history->capacity * 2 : 256;
+        cost_history_entry_t *entries = (cost_history_entry_t*)mvm_alloc(history->context, capacity * sizeof(cost_history_entry_t));
+        if (!entries) {
+            mvm_error(history->context, "couldn't allocate %u history entries", capacity);
+            return false;
+        }
+        if (history->entries) {
+            memcpy(entries, history->entries, history->count * sizeof(cost_history_entry_t));
+            mvm_free(history->context, history->entries);
+        }
+        history->entries = entries;
+        history->capacity = capacity;
+    }
+
+    entry = &history->entries[history->count];
+    entry->name = name;
+    entry->instructions = instructions;
+    entry->order = history->records++;
+    history->count++;
+    return true;
+}
+
+bool mvm_history_load (cost_history_t *history, cchar *filename) {
+    mvm_context_t *context = history->context;
+    buffer_t buffer;
+    char *text;
+    char *line;
+    uint32_t i;
+    uint32_t kept;
+    bool status = true;
+
+    if (!mvm_read_buffer(context, filename, &buffer)) {
+        return false;
+    }
+
+    text = (char*)mvm_alloc(context, buffer.data_size + 1);
+    if (!text) {
+        mvm_error(context, "couldn't allocate %llu bytes for %s", (unsigned long long)(buffer.data_size + 1), filename);
+        mvm_free_buffer(context, &buffer);
+        return false;
+    }
+    memcpy(text, buffer.data, buffer.data_size);
+    mvm_free_buffer(context, &buffer);
+
+    // Lines without a name and an instruction count are skipped
+    for (line = text; status && line && *line; ) {
+        char *next = strchr(line, '\n');
+        char *name;
+        char *count;
+
+        if (next) {
+            *next++ = '\0';
+        }
+
+        name = strstr(line, "\"name\":\"");
+        count = strstr(line, "\"instructions\":");
+        if (name && count) {
+            char *copy = mvm_history_string(context, name + 8);
+            status = copy && mvm_history_add(history, copy, strtoull(count + 15, NULL, 10));
+            if (copy && !status) {
+                mvm_free(context, copy);
+            }
+        }
+
+        line = next;
+    }
+
+    mvm_free(context, text);
+    if (!status) {
+        return false;
+    }
+
+    // Keep the last record for each name
+    qsort(history->entries, history->count, sizeof(cost_history_entry_t), mvm_history_compare);
+    for (i = 0, kept = 0; i < history->count; ++i) {
+        if (i + 1 < history->count && 0 == strcmp(history->entries[i].name, history->entries[i + 1].name)) {
+            mvm_free(context, history->entries[i].name);
+            continue;
+        }
+        history->entries[kept++] = history->entries[i];
+    }
+    history->count = kept;
+
+    return true;
+}
+
+// Long names are looked up the way their records stored them
+bool mvm_history_find (const cost_history_t *history, cchar *name, uint64_t *instructions) {
+    const cost_history_entry_t *entry;
+    char key[RESULT_JSON_NAME_SZ];
+
+    if (history->count == 0) {
+        return false;
+    }
+
+    mvm_results_name(name, key, sizeof(key));
+    entry = (const cost_history_entry_t*)bsearch(key, history->entries, history->count,
+        sizeof(cost_history_entry_t), mvm_history_compare_name);
+    if (!entry) {
+        return false;
+    }
+
+    *instructions = entry->instructions;
+    return true;
+}
+
+void mvm_history_free (cost_history_t *history) {
+    uint32_t i;
+
+    for (i = 0; i < history->count; ++i) {
+        mvm_free(history->context, history->entries[i].name);
+    }
+    mvm_free(history->context, history->entries);
+    history->entries = NULL;
+    history->count = 0;
+    history->capacity = 0;
+}
@@ -0,0 +1,54 @@
+#ifndef _included_minvm_cost_h
+#define _included_minvm_cost_h
+
+#include "minvm_cfg.h"
+
+//
+// Execution cost estimates
+//
+// mvm_estimate_cost() predicts how many instructions a RAM image executes
+// without running it. Every backward jump closes a loop over the addresses
+// between its target and itself. The loop test is the jump itself or, for an
+// unconditional jump, the first conditional jump leaving the loop. When the
+// test compares a register stepped by a single INC or DEC against zero or an
+// unchanged register, and both are loaded by LOADI on the way into the loop,
+// the trip count follows from the loaded values. The way in is the chain of
+// unique predecessors from the loop head, so a loop that control enters from
+// two places, where the registers could differ, is left to the history.
+// Other loops are assumed to run COST_GUESSED_TRIPS times. Each reachable instruction costs the product of
+// the trip counts of the loops around it.
+//
+// A cost history holds the instruction counts of earlier runs, read from a
+// -results JSONL file, for the programs the static estimate can't handle.
+//
+
+#define COST_GUESSED_TRIPS    16
+
+typedef struct cost_estimate_t {
+    uint64_t    instructions;   // Estimated instructions executed
+    uint32_t    loops;          // Backward jumps found
+    uint32_t    guessed;        // Loops whose trip count was guessed
+} cost_estimate_t;
+
+typedef struct cost_history_entry_t {
+    char        *name;
+    uint64_t    instructions;
+    uint32_t    order;          // Records read before it, the last record for a name wins
+} cost_history_entry_t;
+
+typedef struct cost_history_t {
+    mvm_context_t           *context;
+    cost_history_entry_t    *entries;       // Sorted by name
+    uint32_t                count;
+    uint32_t                capacity;
+    uint32_t                records;        // Records read from every file loaded
+} cost_history_t;
+
+void        mvm_estimate_cost (const byte *code, cost_estimate_t *estimate);
+
+void        mvm_history_init (mvm_context_t *context, cost_history_t *history);
+bool        mvm_history_load (cost_history_t *history, cchar *filename);
+bool        mvm_history_find (const cost_history_t *history, cchar *name, uint64_t *instructions);
+void        mvm_history_free (cost_history_t *history);
+
+#endif // _included_minvm_cost_h
@@ -15,8 +15,60 @@ typedef int bool;
 typedef unsigned char byte;
 typedef const char cchar;
 
+// Machine geometry, chosen at compile time. The classic machine has 256 words
+// of RAM and one word addresses. Building with MINVM_ADDRESS_BITS=16 gives the
+// wide machine, 64K words of RAM with two word addresses, see README.md
+#ifndef MINVM_ADDRESS_BITS
+#define MINVM_ADDRESS_BITS 8
+#endif
+
+#if MINVM_ADDRESS_BITS == 8
+typedef byte address_t;
+#define ADDRESS_WORDS     1
+#elif MINVM_ADDRESS_BITS == 16
+typedef uint16_t address_t;
+#define ADDRESS_WORDS     2
+
+// The library functions whose structures or buffers depend on the geometry
+// get a _16 suffix, so code built for one geometry fails to link against a
+// library built for the other instead of corrupting memory
+#define vm_exec                 vm_exec_16
+#define vm_step                 vm_step_16
+#define vm_exec_verified        vm_exec_verified_16
+#define vm_run                  vm_run_16
+#define vm_run_verified         vm_run_verified_16
+#define mvm_context_init        mvm_context_init_16
+#define mvm_vm_init             mvm_vm_init_16
+#define mvm_read_buffer_ram     mvm_read_buffer_ram_16
+#define mvm_validate_buffer     mvm_validate_buffer_16
+#define mvm_decode              mvm_decode_16
+#define mvm_instruction_traps   mvm_instruction_traps_16
+#define mvm_register_uses       mvm_register_uses_16
+#define mvm_successors          mvm_successors_16
+#define mvm_build_cfg           mvm_build_cfg_16
+#define mvm_verify              mvm_verify_16
+#define mvm_result_from_vm      mvm_result_from_vm_16
+#define mvm_estimate_cost       mvm_estimate_cost_16
+#define mvm_itr_dump_state      mvm_itr_dump_state_16
+#define mvm_itr_print_a         mvm_itr_print_a_16
+#define mvm_itr_unassigned      mvm_itr_unassigned_16
+#else
+#error "MINVM_ADDRESS_BITS must be 8 or 16"
+#endif
+
+// A single RAM word is loaded and stored as a relaxed atomic byte access, so
+// cores sharing RAM never race. Both compile to plain byte moves
+#ifdef BUILD_WINDOWS
+#include <intrin.h>
+#define LOAD_WORD(p)        ((byte)__iso_volatile_load8((const volatile char*)(p)))
+#define STORE_WORD(p, v)    __iso_volatile_store8((volatile char*)(p), (char)(v))
+#else
+#define LOAD_WORD(p)        __atomic_load_n((p), __ATOMIC_RELAXED)
+#define STORE_WORD(p, v)    __atomic_store_n((p), (v), __ATOMIC_RELAXED)
+#endif
+
 // Machine constants
-#define RAM_SIZE          256
+#define RAM_SIZE          (1 << MINVM_ADDRESS_BITS)
 #define NUM_REGISTERS     4
 #define WORD_SIZE         8
 
@@ -41,6 +93,9 @@ typedef const char cchar;
 typedef struct virtual_machine_t virtual_machine_t;
 typedef void (*interrupt_function_t)(virtual_machine_t *state);
 
+// Library context, see minvm_context.h
+typedef struct mvm_context_t mvm_context_t;
+
 //
 // Structure representing virtual machine running state, modify this 
 // structure to store the current machine state which will be evaluated after 
@@ -48,10 +103,12 @@ typedef void (*interrupt_function_t)(virtual_machine_t *state);
 // 
 struct virtual_machine_t {
     byte                    flags;          // Machine flags
-    byte                    pc;             // The program counter
+    address_t               pc;             // The program counter, wraps at RAM_SIZE
     byte                    a, b, c, d;     // The general registers
     interrupt_function_t   *interrupts;     // Interrupt table, with 16 possible slots
-    byte                    *code;          // Pointer to core memory, 256 words
+    byte                    *code;          // Pointer to core memory, RAM_SIZE words
+    mvm_context_t           *context;       // Receives interrupt output
+    uint64_t                instructions;   // Instructions executed, kept by the callers of vm_run()
 };
 
 // Prevent unreferenced variable warning
@@ -61,7 +118,8 @@ struct virtual_machine_t {
 #define COUNTOF(a) (sizeof(a) / sizeof(a[0]))
 
 // Default interrupts, other interrupts reserved for extensions
-void itr_dump_state (virtual_machine_t *state);      // ITR 0
-void itr_print_a (virtual_machine_t *state);         // ITR 1
+void mvm_itr_dump_state (virtual_machine_t *state);  // ITR 0
+void mvm_itr_print_a (virtual_machine_t *state);     // ITR 1
+void mvm_itr_unassigned (virtual_machine_t *state);  // Any other slot, halts with an exception
 
 #endif // _included_minvm_defs_h
@@ -16,52 +16,709 @@
 #include <stdlib.h>
 #include <stdarg.h>
 
-#include "minvm_defs.h"
-#include "minvm_int.h"
+#include "minvm.h"
 
-extern void vm_exec(virtual_machine_t *vm);
+// Multi-core, memo, sweep and network runs need the classic geometry
+#if MINVM_ADDRESS_BITS == 8
+#define DRIVER_EXTENSIONS 1
+#else
+#define DRIVER_EXTENSIONS 0
+#endif
 
-static interrupt_function_t s_interrupts[16] = {
-    itr_dump_state,
-    itr_print_a
-};
+typedef struct driver_options_t {
+    cchar       *results;       // Write a record per program here instead of printing the final state
+    mvm_results_format_t format;
+    bool        batch;          // Run the files on -jobs threads, longest estimate first
+    uint32_t    jobs;           // Threads, 0 for one per CPU
+    cchar       *history;       // Instruction counts of earlier runs, a -results JSONL file
+#if DRIVER_EXTENSIONS
+    uint32_t    cores;          // Run each file on this many cores sharing RAM, 0 for the single VM
+    bool        replay;         // Interleave the cores deterministically on one thread
+    bool        compare;        // Run both replay and parallel and compare the final states
+    bool        memo;           // Memoize basic blocks
+    bool        sweep;          // Run every initial state given by -vary
+    cchar       *net;           // Wiring description of a network of machines
+    sweep_spec_t spec;
+#endif
+} driver_options_t;
 
-int main(int argc, char **argv) {
+static void print_usage () {
+#if DRIVER_EXTENSIONS
+    printf("usage: ./vm [options] <filename> [filename]\n");
+    printf("       ./vm -net <wiring> [-jobs N]\n");
+    printf("  -cores N     run each file on N cores sharing one RAM image\n");
+    printf("  -replay      with -cores, interleave the cores deterministically on one thread\n");
+    printf("  -compare     with -cores, run replay and parallel and compare the final states\n");
+    printf("  -memo        skip basic blocks whose outputs are cached for the current registers\n");
+    printf("  -vary X=V    sweep register a-d or memory @address over values V, e.g. a=0-255 or @0x40=1,2,4\n");
+    printf("  -limit N     with -vary, stop each run after N instructions\n");
+    printf("  -net FILE    run the machines and channels described in FILE\n");
+    printf("  -jobs N      run on N threads: the files longest estimated first, or a -vary or -net run\n");
+    printf("  -show N      with -vary, print N final states and distinct outputs\n");
+#else
+    printf("usage: ./vm16 [options] <filename> [filename]\n");
+#endif
+    printf("  -results F   write a record per program to file F in place of the running and final state lines\n");
+    printf("  -format X    with -results, write jsonl (default) or binary records\n");
+#if !DRIVER_EXTENSIONS
+    printf("  -jobs N      run the files on N threads, longest estimated first\n");
+#endif
+    printf("  -history F   with -jobs, use instruction counts from the -results JSONL file F\n");
+}
+
+// Returns the index of the first filename, or 0 on a bad option
+static int parse_options (mvm_context_t *context, int argc, char **argv, driver_options_t *options) {
     int i;
-    buffer_t buffer;
-    virtual_machine_t vm = { 0, 0, 0, 0, 0, 0, &s_interrupts[0] };
 
-    if (argc < 2) {
-        printf("usage: ./vm <filename> [filename]\n");
-        return -1;
+    memset(options, 0, sizeof(*options));
+#if DRIVER_EXTENSIONS
+    mvm_sweep_init(&options->spec);
+#endif
+
+    for (i = 1; i < argc && argv[i][0] == '-'; ++i) {
+        if (0 == strcmp(argv[i], "-results") && i + 1 < argc) {
+            options->results = argv[++i];
+        } else if (0 == strcmp(argv[i], "-format") && i + 1 < argc) {
+            if (!mvm_results_parse_format(argv[++i], &options->format)) {
+                mvm_error(context, "unknown results format: %s", argv[i]);
+                return 0;
+            }
+        } else if (0 == strcmp(argv[i], "-jobs") && i + 1 < argc) {
+            options->jobs = (uint32_t)strtoul(argv[++i], NULL, 0);
+            options->batch = true;
+        } else if (0 == strcmp(argv[i], "-history") && i + 1 < argc) {
+            options->history = argv[++i];
+#if DRIVER_EXTENSIONS
+        } else if (0 == strcmp(argv[i], "-cores") && i + 1 < argc) {
+            options->cores = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (0 == strcmp(argv[i], "-replay")) {
+            options->replay = true;
+        } else if (0 == strcmp(argv[i], "-compare")) {
+            options->compare = true;
+        } else if (0 == strcmp(argv[i], "-memo")) {
+            options->memo = true;
+        } else if (0 == strcmp(argv[i], "-vary") && i + 1 < argc) {
+            if (!mvm_sweep_parse(context, &options->spec, argv[++i])) {
+                return 0;
+            }
+            options->sweep = true;
+        } else if (0 == strcmp(argv[i], "-net") && i + 1 < argc) {
+            options->net = argv[++i];
+        } else if (0 == strcmp(argv[i], "-limit") && i + 1 < argc) {
+            options->spec.limit = strtoull(argv[++i], NULL, 0);
+        } else if (0 == strcmp(argv[i], "-show") && i + 1 < argc) {
+            options->spec.show = (uint32_t)strtoul(argv[++i], NULL, 0);
+#endif
+        } else {
+            mvm_error(context, "unknown option: %s", argv[i]);
+            return 0;
+        }
+    }
+
+#if DRIVER_EXTENSIONS
+    if ((options->replay || options->compare) && options->cores == 0) {
+        mvm_error(context, "-replay and -compare require -cores");
+        return 0;
+    }
+
+    if (options->memo && options->cores > 0) {
+        mvm_error(context, "-memo can't be combined with -cores");
+        return 0;
+    }
+
+    if (options->sweep && (options->cores > 0 || options->memo)) {
+        mvm_error(context, "-vary can't be combined with -cores or -memo");
+        return 0;
+    }
+
+    if (options->net && (options->cores > 0 || options->memo || options->sweep)) {
+        mvm_error(context, "-net can't be combined with -cores, -memo or -vary");
+        return 0;
+    }
+
+    if (options->results && (options->cores > 0 || options->sweep || options->net)) {
+        mvm_error(context, "-results can't be combined with -cores, -vary or -net");
+        return 0;
+    }
+
+    if (options->batch && options->cores > 0) {
+        mvm_error(context, "-jobs can't be combined with -cores");
+        return 0;
+    }
+
+    // Sweeps and networks use the threads themselves
+    options->spec.jobs = options->jobs;
+    if (options->sweep || options->net) {
+        options->batch = false;
+    }
+#endif
+
+    if (options->history && !options->batch) {
+        mvm_error(context, "-history requires -jobs");
+        return 0;
+    }
+
+    return i;
+}
+
+#if DRIVER_EXTENSIONS
+static void print_cores (mvm_context_t *context, const mvm_cores_t *machine) {
+    uint32_t i;
+
+    for (i = 0; i < machine->count; ++i) {
+        const virtual_machine_t *core = &machine->cores[i].vm;
+        mvm_info(context, "core %u %s PC: 0x%02x, A: 0x%02x, B: 0x%02x, C: 0x%02x, D: 0x%02x", i,
+            ((core->flags & MINVM_EXCEPTION) ? "EXCEPTION" : "HALT"),
+            core->pc, core->a, core->b, core->c, core->d);
+    }
+}
+
+// Final flags, program counter and registers of every core, and the shared RAM, a difference is an error
+static bool same_cores (mvm_context_t *context, const mvm_cores_t *left, const byte *left_ram,
+                        const mvm_cores_t *right, const byte *right_ram) {
+    uint32_t i;
+
+    for (i = 0; i < left->count; ++i) {
+        const virtual_machine_t *l = &left->cores[i].vm;
+        const virtual_machine_t *r = &right->cores[i].vm;
+        if (l->flags != r->flags || l->pc != r->pc
+            || l->a != r->a || l->b != r->b || l->c != r->c || l->d != r->d) {
+            mvm_error(context, "core %u differs between replay and parallel runs", i);
+            return false;
+        }
+    }
+
+    if (0 != memcmp(left_ram, right_ram, RAM_SIZE)) {
+        mvm_error(context, "RAM differs between replay and parallel runs");
+        return false;
+    }
+
+    return true;
+}
+
+// The summary line is left out when records keep stdout to the guest output
+static bool run_memo (mvm_context_t *context, virtual_machine_t *vm, bool summary) {
+    memo_t *memo = mvm_memo_create(context);
+    if (!memo) {
+        return false;
+    }
+
+    mvm_exec_memo(vm, memo);
+    if (summary) {
+        mvm_info(context, "## memo: %llu instructions, %llu hits, %llu misses, %llu invalidations",
+            (unsigned long long)memo->instructions, (unsigned long long)memo->hits,
+            (unsigned long long)memo->misses, (unsigned long long)memo->invalidations);
+    }
+
+    mvm_memo_free(context, memo);
+    return true;
+}
+
+static bool run_network (mvm_context_t *context, const driver_options_t *options) {
+    mvm_network_t network;
+    uint64_t messages = 0;
+    uint32_t blocked = 0;
+    uint32_t i;
+    bool status;
+
+    mvm_network_init(context, &network);
+    status = mvm_network_load(&network, options->net);
+    if (status) {
+        mvm_info(context, "## running: %s, %u machines", options->net, network.count);
+        status = mvm_network_run(&network, options->spec.jobs);
     }
 
-    for (i = 1; i < argc; ++i) {
-        cchar *filename = argv[i];
-        if (!mvm_read_buffer_ram(filename, &buffer)) {
-            mvm_error("failed to buffer file");
+    for (i = 0; status && i < network.count; ++i) {
+        const mvm_node_t *node = &network.nodes[i];
+        const virtual_machine_t *vm = &node->vm;
+        messages += node->messages;
+        if (node->blocked) {
+            blocked++;
+        }
+        mvm_info(context, "%s %s PC: 0x%02x, A: 0x%02x, B: 0x%02x, C: 0x%02x, D: 0x%02x", node->name,
+            node->blocked ? (node->sending ? "BLOCKED SEND" : "BLOCKED RECEIVE")
+                          : ((vm->flags & MINVM_EXCEPTION) ? "EXCEPTION" : "HALT"),
+            vm->pc, vm->a, vm->b, vm->c, vm->d);
+    }
+
+    if (status) {
+        mvm_info(context, "## network: %llu bytes sent, %u machines blocked", (unsigned long long)messages, blocked);
+    }
+
+    // Machines are only left blocked when none of them can ever continue
+    if (status && blocked > 0) {
+        mvm_error(context, "network deadlock: %u machines blocked for good", blocked);
+        status = false;
+    }
+
+    mvm_network_free(&network);
+    return status;
+}
+
+static bool run_cores (mvm_context_t *context, const driver_options_t *options, byte *ram) {
+    mvm_cores_t machine;
+    mvm_cores_t replayed;
+    byte replay_ram[RAM_SIZE];
+    bool status;
+
+    if (!options->compare) {
+        status = mvm_cores_run(context, &machine, ram, options->cores, options->replay);
+        print_cores(context, &machine);
+        mvm_cores_free(&machine);
+        return status;
+    }
+
+    memcpy(replay_ram, ram, RAM_SIZE);
+    status = mvm_cores_run(context, &replayed, replay_ram, options->cores, true)
+          && mvm_cores_run(context, &machine, ram, options->cores, false);
+
+    if (status) {
+        print_cores(context, &machine);
+        status = same_cores(context, &replayed, replay_ram, &machine, ram);
+        if (status) {
+            mvm_info(context, "## replay and parallel runs match");
+        }
+    }
+
+    mvm_cores_free(&replayed);
+    mvm_cores_free(&machine);
+    return status;
+}
+#endif
+
+// Result records, and the guest output counted on its way to the original sink
+typedef struct driver_results_t {
+    mvm_results_t       results;
+    mvm_sink_function_t sink;
+    void                *sink_user;
+    uint64_t            output;
+} driver_results_t;
+
+static void count_output (void *user, mvm_stream_t stream, cchar *text, size_t size) {
+    driver_results_t *records = (driver_results_t*)user;
+
+    if (stream == MVM_OUTPUT) {
+        records->output += size;
+    }
+    records->sink(records->sink_user, stream, text, size);
+}
+
+static bool open_results (mvm_context_t *context, const driver_options_t *options, driver_results_t *records) {
+    if (!mvm_results_open(context, &records->results, options->results, options->format)) {
+        return false;
+    }
+
+    records->sink = context->sink;
+    records->sink_user = context->sink_user;
+    records->output = 0;
+    context->sink = count_output;
+    context->sink_user = records;
+    return true;
+}
+
+// Programs proven safe at load time skip the operand checks. Only records and batch cost lines need
+// the instruction count, other runs use the engines that don't keep one
+static bool run_vm (mvm_context_t *context, const driver_options_t *options, virtual_machine_t *vm, bool *verified) {
+    verify_report_t report;
+    bool count = options->results || options->batch;
+
+    *verified = false;
+
+#if DRIVER_EXTENSIONS
+    if (options->memo) {
+        return run_memo(context, vm, !options->results);
+    }
+#endif
+
+    if (mvm_verify(vm->code, &report)) {
+        *verified = true;
+        if (count) {
+            vm->instructions += vm_run_verified(vm, (uint64_t)-1);
+        } else {
+            vm_exec_verified(vm);
+        }
+    } else {
+        if (!options->results) {
+            mvm_info(context, "## unverified: %s", report.reason);
+        }
+        if (count) {
+            vm->instructions += vm_run(vm, (uint64_t)-1);
+        } else {
+            vm_exec(vm);
+        }
+    }
+
+    return true;
+}
+
+// Records the final state, or prints it when there is no results file
+static bool report_vm (mvm_context_t *context, driver_results_t *records, cchar *filename,
+                       const virtual_machine_t *vm, bool verified, uint64_t output) {
+    mvm_result_t result;
+
+    if (!records) {
+        mvm_info(context, "%s PC: 0x%02x, A: 0x%02x, B: 0x%02x, C: 0x%02x, D: 0x%02x",
+            ((vm->flags & MINVM_EXCEPTION) ? "EXCEPTION" : "HALT"),
+            vm->pc, vm->a, vm->b, vm->c, vm->d);
+        return true;
+    }
+
+    mvm_result_from_vm(&result, filename, vm);
+    result.output_size = output;
+    result.verified = verified;
+    return mvm_results_write(&records->results, &result);
+}
+
+static int run_files (mvm_context_t *context, const driver_options_t *options, driver_results_t *records,
+                      int count, char **filenames) {
+    buffer_t buffer;
+    virtual_machine_t vm;
+    bool verified;
+    int i;
+
+    for (i = 0; i < count; ++i) {
+        cchar *filename = filenames[i];
+        if (!mvm_read_buffer_ram(context, filename, &buffer)) {
+            mvm_error(context, "failed to buffer file");
             return -1;
         }
 
         if (buffer.data_size > RAM_SIZE) {
-            mvm_error("%s: invalid RAM: %u", filename, buffer.data_size);
-            mvm_free_buffer(&buffer);
+            mvm_error(context, "%s: invalid RAM: %u", filename, buffer.data_size);
+            mvm_free_buffer(context, &buffer);
             return -1;
         }
 
-        mvm_info("## running: %s, %u bytes", filename, buffer.data_size);
-        vm.code = (byte*)buffer.data;
+        if (!records) {
+            mvm_info(context, "## running: %s, %u bytes", filename, buffer.data_size);
+        }
+
+#if DRIVER_EXTENSIONS
+        if (options->cores > 0) {
+            if (!run_cores(context, options, buffer.data)) {
+                mvm_free_buffer(context, &buffer);
+                return -1;
+            }
+            if (!mvm_free_buffer(context, &buffer)) {
+                return 1;
+            }
+            continue;
+        }
 
-        vm_exec(&vm);
-        if (vm.flags & MINVM_HALT) {
-            mvm_info("%s PC: 0x%02x, A: 0x%02x, B: 0x%02x, C: 0x%02x, D: 0x%02x",
-                ((vm.flags & MINVM_EXCEPTION) ? "EXCEPTION" : "HALT"),
-                vm.pc, vm.a, vm.b, vm.c, vm.d);
+        if (options->sweep) {
+            if (!mvm_sweep_run(context, &options->spec, buffer.data)) {
+                mvm_free_buffer(context, &buffer);
+                return -1;
+            }
+            if (!mvm_free_buffer(context, &buffer)) {
+                return 1;
+            }
+            continue;
+        }
+#endif
+
+        if (records) {
+            records->output = 0;
+        }
+        mvm_vm_init(&vm, context, buffer.data);
+        if (!run_vm(context, options, &vm, &verified)) {
+            mvm_free_buffer(context, &buffer);
+            return -1;
+        }
+        if ((vm.flags & MINVM_HALT) && !report_vm(context, records, filename, &vm, verified, records ? records->output : 0)) {
+            mvm_free_buffer(context, &buffer);
+            return -1;
         }
-        if (!mvm_free_buffer(&buffer)) {
+        if (!mvm_free_buffer(context, &buffer)) {
             return 1;
         }
     }
 
     return 0;
 }
+
+// A program of a batch, run on its own context so its lines can be printed in order
+typedef struct batch_program_t {
+    cchar               *filename;
+    mvm_context_t       context;
+    mvm_context_t       *parent;        // Receives errors straight away
+    bool                records;        // Keep guest output only, the rest goes to the results file
+    virtual_machine_t   vm;
+    bool                done;
+    bool                ran;
+    bool                verified;
+    bool                freed;          // Buffer guard bytes were intact
+    char                *text;          // Guest output and messages, until printed
+    size_t              size;
+    size_t              capacity;
+    bool                truncated;      // Couldn't grow text
+    uint64_t            output;         // Guest output bytes
+    uint64_t            estimate;       // Estimated instructions
+    cchar               *source;        // Where the estimate came from
+} batch_program_t;
+
+typedef struct batch_run_t {
+    const driver_options_t  *options;
+    mvm_context_t           *context;
+    driver_results_t        *records;
+    batch_program_t         *programs;
+    uint32_t                count;
+    mvm_mutex_t             lock;           // Guards done and everything below
+    uint32_t                printed;        // Programs printed so far, in the order given
+    int                     status;
+    uint64_t                estimated;
+    uint64_t                executed;
+    uint32_t                close;
+} batch_run_t;
+
+static void capture_output (void *user, mvm_stream_t stream, cchar *text, size_t size) {
+    batch_program_t *program = (batch_program_t*)user;
+
+    if (stream == MVM_ERROR) {
+        mvm_write(program->parent, stream, text, size);
+        return;
+    }
+    if (stream == MVM_OUTPUT) {
+        program->output += size;
+    } else if (program->records) {
+        return;
+    }
+
+    if (program->size + size > program->capacity) {
+        size_t capacity = program->capacity ? program->capacity : 256;
+        char *grown;
+        while (capacity < program->size + size) {
+            capacity *= 2;
+        }
+        grown = (char*)mvm_alloc(program->parent, capacity);
+        if (!grown) {
+            program->truncated = true;
+            return;
+        }
+        if (program->text) {
+            memcpy(grown, program->text, program->size);
+            mvm_free(program->parent, program->text);
+        }
+        program->text = grown;
+        program->capacity = capacity;
+    }
+
+    memcpy(program->text + program->size, text, size);
+    program->size += size;
+}
+
+static bool load_program (mvm_context_t *context, cchar *filename, buffer_t *buffer) {
+    if (!mvm_read_buffer_ram(context, filename, buffer)) {
+        mvm_error(context, "failed to buffer file");
+        return false;
+    }
+
+    if (buffer->data_size > RAM_SIZE) {
+        mvm_error(context, "%s: invalid RAM: %u", filename, buffer->data_size);
+        mvm_free_buffer(context, buffer);
+        return false;
+    }
+
+    return true;
+}
+
+// Static estimates with a guessed trip count give way to the count of an earlier run
+static void estimate_program (batch_program_t *program, const byte *code, const cost_history_t *history) {
+    cost_estimate_t estimate;
+
+    mvm_estimate_cost(code, &estimate);
+    program->estimate = estimate.instructions;
+    program->source = "static";
+
+    if (estimate.guessed > 0) {
+        program->source = "guessed";
+        if (mvm_history_find(history, program->filename, &program->estimate)) {
+            program->source = "history";
+        }
+    }
+}
+
+// Prints a finished program's lines and cost, then drops its text. Once one fails the rest are
+// only dropped, as a sequential run would have stopped there
+static void print_batch_program (batch_run_t *batch, batch_program_t *program) {
+    mvm_context_t *context = batch->context;
+    const virtual_machine_t *vm = &program->vm;
+
+    if (batch->status == 0) {
+        if (!batch->records) {
+            mvm_info(context, "## running: %s, %u bytes", program->filename, (uint32_t)RAM_SIZE);
+        }
+        if (program->size > 0) {
+            mvm_write(context, MVM_OUTPUT, program->text, program->size);
+        }
+        if (program->truncated) {
+            mvm_error(context, "%s: couldn't keep all of its output", program->filename);
+        }
+
+        if (!program->ran) {
+            batch->status = -1;
+        } else if ((vm->flags & MINVM_HALT) && !report_vm(context, batch->records, program->filename, vm, program->verified, program->output)) {
+            batch->status = -1;
+        } else {
+            if (!batch->records) {
+                mvm_info(context, "## cost: estimated %llu (%s), actual %llu",
+                    (unsigned long long)program->estimate, program->source, (unsigned long long)vm->instructions);
+            }
+            if (!program->freed) {
+                batch->status = 1;
+            }
+
+            batch->estimated += program->estimate;
+            batch->executed += vm->instructions;
+            if (program->estimate <= 2 * vm->instructions && vm->instructions <= 2 * program->estimate) {
+                batch->close++;
+            }
+        }
+    }
+
+    mvm_free(context, program->text);
+    program->text = NULL;
+    program->size = 0;
+    program->capacity = 0;
+}
+
+// Reloads the image rather than keeping it from the estimate, so only running programs hold one
+static void run_batch_program (void *user, uint32_t job) {
+    batch_run_t *batch = (batch_run_t*)user;
+    batch_program_t *program = &batch->programs[job];
+    buffer_t buffer;
+
+    if (load_program(&program->context, program->filename, &buffer)) {
+        mvm_vm_init(&program->vm, &program->context, buffer.data);
+        program->ran = run_vm(&program->context, batch->options, &program->vm, &program->verified);
+        program->freed = mvm_free_buffer(&program->context, &buffer);
+    }
+
+    // Print every finished program that no earlier one is still holding back
+    mvm_mutex_lock(&batch->lock);
+    program->done = true;
+    while (batch->printed < batch->count && batch->programs[batch->printed].done) {
+        print_batch_program(batch, &batch->programs[batch->printed]);
+        batch->printed++;
+    }
+    mvm_mutex_unlock(&batch->lock);
+}
+
+// Loads each file in turn to estimate its cost, runs them on -jobs threads longest first, and
+// prints each program's lines with its estimated and actual cost as soon as all the programs
+// given before it have been printed
+static int run_batch (mvm_context_t *context, const driver_options_t *options, driver_results_t *records,
+                      int count, char **filenames) {
+    batch_run_t batch;
+    batch_program_t *programs;
+    cost_history_t history;
+    uint64_t *costs;
+    int status = 0;
+    int i;
+
+    mvm_history_init(context, &history);
+    if (options->history && !mvm_history_load(&history, options->history)) {
+        mvm_error(context, "failed to read history: %s", options->history);
+        return -1;
+    }
+
+    programs = (batch_program_t*)mvm_alloc(context, count * sizeof(batch_program_t));
+    costs = (uint64_t*)mvm_alloc(context, count * sizeof(uint64_t));
+    if (!programs || !costs) {
+        mvm_error(context, "couldn't allocate a batch of %u programs", count);
+        mvm_free(context, programs);
+        mvm_free(context, costs);
+        mvm_history_free(&history);
+        return -1;
+    }
+    memset(programs, 0, count * sizeof(batch_program_t));
+
+    for (i = 0; i < count; ++i) {
+        batch_program_t *program = &programs[i];
+        buffer_t buffer;
+
+        program->filename = filenames[i];
+        if (!load_program(context, program->filename, &buffer)) {
+            status = -1;
+            break;
+        }
+
+        mvm_context_init(&program->context);
+        program->context.sink = capture_output;
+        program->context.sink_user = program;
+        program->parent = context;
+        program->records = (records != NULL);
+
+        estimate_program(program, buffer.data, &history);
+        costs[i] = program->estimate;
+        mvm_free_buffer(context, &buffer);
+    }
+
+    mvm_history_free(&history);
+
+    memset(&batch, 0, sizeof(batch));
+    batch.options = options;
+    batch.context = context;
+    batch.records = records;
+    batch.programs = programs;
+    batch.count = (uint32_t)count;
+    mvm_mutex_init(&batch.lock);
+
+    if (status == 0 && !mvm_batch_run(context, costs, count, options->jobs, run_batch_program, &batch)) {
+        status = -1;
+    }
+    if (status == 0) {
+        status = batch.status;
+    }
+
+    if (status == 0 && !records) {
+        mvm_info(context, "## batch: %u programs, %llu instructions estimated, %llu executed, %u estimates within 2x",
+            count, (unsigned long long)batch.estimated, (unsigned long long)batch.executed, batch.close);
+    }
+
+    // Left over only when the batch couldn't run
+    for (i = 0; i < count; ++i) {
+        mvm_free(context, programs[i].text);
+    }
+    mvm_mutex_destroy(&batch.lock);
+    mvm_free(context, programs);
+    mvm_free(context, costs);
+    return status;
+}
+
+int main(int argc, char **argv) {
+    int i;
+    int status;
+    driver_options_t options;
+    driver_results_t records;
+    mvm_context_t context;
+
+    mvm_context_init(&context);
+
+    i = parse_options(&context, argc, argv, &options);
+#if DRIVER_EXTENSIONS
+    if (i > 0 && options.net) {
+        return run_network(&context, &options) ? 0 : -1;
+    }
+#endif
+    if (i == 0 || i >= argc) {
+        print_usage();
+        return -1;
+    }
+
+    if (!options.results) {
+        return options.batch ? run_batch(&context, &options, NULL, argc - i, argv + i)
+                             : run_files(&context, &options, NULL, argc - i, argv + i);
+    }
+
+    if (!open_results(&context, &options, &records)) {
+        return -1;
+    }
+    status = options.batch ? run_batch(&context, &options, &records, argc - i, argv + i)
+                           : run_files(&context, &options, &records, argc - i, argv + i);
+    if (!mvm_results_close(&records.results) && status == 0) {
+        status = -1;
+    }
+
+    return status;
+}
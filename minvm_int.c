@@ -8,42 +8,55 @@
 #include <errno.h>
 
 #include "minvm_defs.h"
+#include "minvm_context.h"
 #include "minvm_int.h"
+#include "minvm_thread.h"
 
 
 #define BUFFER_PADDING  256
 #define BUFFER_FILL     0xBB
 
-static uint32_t s_errors = 0;
+uint32_t mvm_error_count (const mvm_context_t *context) {
+    return mvm_atomic_load((volatile uint32_t*)&context->errors);
+}
+
+// Formats prefix, message and a newline into one write so lines from different threads don't mix
+static void mvm_vlog (mvm_context_t *context, mvm_stream_t stream, cchar *prefix, cchar *fmt, va_list ap) {
+    char line[MVM_LINE_SZ];
+    size_t size = strlen(prefix);
+    int n;
+
+    memcpy(line, prefix, size);
+    n = mvm_vprint_string(line + size, (uint32_t)(sizeof(line) - size - 1), fmt, ap);
+    if (n < 0 || size + n > sizeof(line) - 2) {
+        size = sizeof(line) - 2;
+    } else {
+        size += n;
+    }
+    line[size++] = '\n';
 
-uint32_t mvm_error_count () {
-    return s_errors;
+    mvm_write(context, stream, line, size);
 }
 
-void mvm_error (cchar *fmt, ...) {
+void mvm_error (mvm_context_t *context, cchar *fmt, ...) {
     va_list ap;
 
-    fprintf(stderr, "ERROR: ");
     va_start(ap, fmt);
-    vfprintf(stderr, fmt, ap);
+    mvm_vlog(context, MVM_ERROR, "ERROR: ", fmt, ap);
     va_end(ap);
-    fprintf(stderr, "\n");
-    fflush(stderr);
 
-    s_errors++;
+    mvm_atomic_increment(&context->errors); // Multi-core, sweep and batch runs log from several threads
 }
 
-void mvm_info (cchar *fmt, ...) {
+void mvm_info (mvm_context_t *context, cchar *fmt, ...) {
     va_list ap;
 
     va_start(ap, fmt);
-    vfprintf(stdout, fmt, ap);
+    mvm_vlog(context, MVM_INFO, "", fmt, ap);
     va_end(ap);
-    fprintf(stdout, "\n");
-    fflush(stdout);
 }
 
-int mvm_file_open (file_t *f, cchar *filename, cchar *mode) {
+int mvm_file_open (mvm_context_t *context, file_t *f, cchar *filename, cchar *mode) {
     struct stat st;
 
 #if BUILD_WINDOWS
@@ -62,14 +75,14 @@ int mvm_file_open (file_t *f, cchar *filename, cchar *mode) {
         int error = errno;
         char message[MESSAGE_SZ];
         mvm_get_error(message, sizeof(message), error);
-        mvm_error("minvm_file_open: couldn't open file: %s: %s", filename, message);
+        mvm_error(context, "minvm_file_open: couldn't open file: %s: %s", filename, message);
         return error;
     }
 
     if (0 != stat(filename, &st)) {
         fclose(f->stream);
         f->stream = NULL;
-        mvm_error("mvm_file_open: couldn't stat: %s", filename);
+        mvm_error(context, "mvm_file_open: couldn't stat: %s", filename);
         return 0;
     }
 
@@ -110,12 +123,12 @@ int mvm_isoneof (cchar c, cchar *str) {
     return 0;
 }
 
-bool mvm_buffer_alloc (buffer_t* buffer, size_t size) {
+static bool mvm_buffer_alloc (mvm_context_t *context, buffer_t* buffer, size_t size) {
     // Reserve buffer size and fixed padding
     size_t buffer_size = size + (2 * BUFFER_PADDING);
-    byte* allocated = (byte*)malloc(buffer_size);
+    byte* allocated = (byte*)context->alloc(context->alloc_user, buffer_size);
     if (!allocated) {
-        mvm_error("couldn't allocate buffer %u bytes", buffer_size);
+        mvm_error(context, "couldn't allocate buffer %u bytes", buffer_size);
         return false;
     }
 
@@ -132,31 +145,31 @@ bool mvm_buffer_alloc (buffer_t* buffer, size_t size) {
     return true;
 }
 
-bool mvm_read_buffer_internal (file_t* file, buffer_t *buffer, size_t size) {
+static bool mvm_read_buffer_internal (mvm_context_t *context, file_t* file, buffer_t *buffer, size_t size) {
     size_t read = fread(buffer->data, 1, size, file->stream);
     if (size != read) {
-        mvm_error("mvm_read_buffer_internal: read failed %u != %u", read, size);
+        mvm_error(context, "mvm_read_buffer_internal: read failed %u != %u", read, size);
         return false;
     }
 
     return true;
 }
 
-bool mvm_read_buffer (cchar *filename, buffer_t *buffer) {
+bool mvm_read_buffer (mvm_context_t *context, cchar *filename, buffer_t *buffer) {
     file_t f = { 0, };
 
-    if (ERR_OK != mvm_file_open(&f, filename, "rb")) {
+    if (ERR_OK != mvm_file_open(context, &f, filename, "rb")) {
         return false;
     }
 
     // Allocate a buffer to the size of the file
-    if (!mvm_buffer_alloc(buffer, f.size)) {
+    if (!mvm_buffer_alloc(context, buffer, f.size)) {
         return false;
     }
 
-    if (!mvm_read_buffer_internal(&f, buffer, f.size)) {
+    if (!mvm_read_buffer_internal(context, &f, buffer, f.size)) {
         mvm_file_close(&f);
-        mvm_free_buffer(buffer);
+        mvm_free_buffer(context, buffer);
         return false;
     }
 
@@ -166,22 +179,22 @@ bool mvm_read_buffer (cchar *filename, buffer_t *buffer) {
 }
 
 
-bool mvm_read_buffer_ram (cchar *filename, buffer_t *buffer) {
+bool mvm_read_buffer_ram (mvm_context_t *context, cchar *filename, buffer_t *buffer) {
     file_t f = { 0, };
 
-    if (ERR_OK != mvm_file_open(&f, filename, "rb")) {
+    if (ERR_OK != mvm_file_open(context, &f, filename, "rb")) {
         return false;
     }
 
     // Check the size of the file
     if (f.size > RAM_SIZE) { 
-      mvm_error("mvm_read_buffer_ram: file size exceeds RAM size RAM_SIZE");
+      mvm_error(context, "mvm_read_buffer_ram: file size exceeds RAM size RAM_SIZE");
       mvm_file_close(&f);
       return false;
     }
 
     // Allocate the buffer for the RAM
-    if (!mvm_buffer_alloc(buffer, RAM_SIZE)) {
+    if (!mvm_buffer_alloc(context, buffer, RAM_SIZE)) {
         return false;
     }
 
@@ -189,9 +202,9 @@ bool mvm_read_buffer_ram (cchar *filename, buffer_t *buffer) {
     memset(buffer->data, 0, RAM_SIZE);
 
     // Read contents or fail
-    if (!mvm_read_buffer_internal(&f, buffer, f.size)) {
+    if (!mvm_read_buffer_internal(context, &f, buffer, f.size)) {
         mvm_file_close(&f);
-        mvm_free_buffer(buffer);
+        mvm_free_buffer(context, buffer);
         return false;
     }
 
@@ -200,12 +213,12 @@ bool mvm_read_buffer_ram (cchar *filename, buffer_t *buffer) {
     return true;
 }
 
-int mvm_check_bytes (byte *data, uint32_t offset, uint32_t count, byte check) {
+int mvm_check_bytes (mvm_context_t *context, byte *data, uint32_t offset, uint32_t count, byte check) {
     uint32_t end;
 
     for (end = offset + count; offset < end; ++offset) {
         if (data[offset] != check) {
-            mvm_error("mvm_check_bytes: corrupt byte (0x%02x) at offset: %u", data[offset], offset);
+            mvm_error(context, "mvm_check_bytes: corrupt byte (0x%02x) at offset: %u", data[offset], offset);
             return 0;
         }
     }
@@ -213,24 +226,24 @@ int mvm_check_bytes (byte *data, uint32_t offset, uint32_t count, byte check) {
     return 1;
 }
 
-bool mvm_validate_buffer (const buffer_t *buffer) {
-    if (!mvm_check_bytes(buffer->base_ptr, 0, BUFFER_PADDING, BUFFER_FILL)) {
+bool mvm_validate_buffer (mvm_context_t *context, const buffer_t *buffer) {
+    if (!mvm_check_bytes(context, buffer->base_ptr, 0, BUFFER_PADDING, BUFFER_FILL)) {
         return false;
     }
 
     if (buffer->base_size < BUFFER_PADDING) {
-        mvm_error("mvm_validate_buffer: base_size (%u) < BUFFER_PADDING (%u)", buffer->base_size, BUFFER_PADDING);
+        mvm_error(context, "mvm_validate_buffer: base_size (%u) < BUFFER_PADDING (%u)", buffer->base_size, BUFFER_PADDING);
         return false;
     }
 
-    if (!mvm_check_bytes(buffer->base_ptr, buffer->base_size - BUFFER_PADDING, BUFFER_PADDING, BUFFER_FILL)) {
+    if (!mvm_check_bytes(context, buffer->base_ptr, buffer->base_size - BUFFER_PADDING, BUFFER_PADDING, BUFFER_FILL)) {
         return false;
     }
 
     return true;
 }
 
-bool mvm_free_buffer (buffer_t *buffer) {
+bool mvm_free_buffer (mvm_context_t *context, buffer_t *buffer) {
     bool status = true;
 
     if (!buffer) {
@@ -239,16 +252,16 @@ bool mvm_free_buffer (buffer_t *buffer) {
 
     // Check the padding bytes in the buffer
     status = true;
-    if (!mvm_check_bytes(buffer->base_ptr, 0, BUFFER_PADDING, BUFFER_FILL)) {
+    if (!mvm_check_bytes(context, buffer->base_ptr, 0, BUFFER_PADDING, BUFFER_FILL)) {
         status = false;
     }
 
-    if (!mvm_check_bytes(buffer->base_ptr, BUFFER_PADDING + buffer->data_size, BUFFER_PADDING, BUFFER_FILL)) {
+    if (!mvm_check_bytes(context, buffer->base_ptr, BUFFER_PADDING + buffer->data_size, BUFFER_PADDING, BUFFER_FILL)) {
         status = false;
     }
 
     if (buffer->base_ptr) {
-      free(buffer->base_ptr);
+      context->free(context->alloc_user, buffer->base_ptr);
     }
 
     buffer->base_ptr = NULL;
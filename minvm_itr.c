@@ -1,13 +1,23 @@
 
 #include <stdio.h>
+#include <stdarg.h>
 #include "minvm_defs.h"
+#include "minvm_context.h"
+#include "minvm_int.h"
 
-void itr_dump_state(virtual_machine_t *state) {
-    printf("PC: %u (Flags: 0x%02x): A: %02x B: %02x C: %02x D: %02x\n", 
+void mvm_itr_dump_state(virtual_machine_t *state) {
+    char line[MESSAGE_SZ];
+    int n = mvm_print_string(line, sizeof(line), "PC: %u (Flags: 0x%02x): A: %02x B: %02x C: %02x D: %02x\n", 
         state->pc, state->flags, state->a, state->b, state->c, state->d);
+    mvm_write(state->context, MVM_OUTPUT, line, n);
 }
 
-void itr_print_a(virtual_machine_t *state) {
-    printf("%c", state->a);
+void mvm_itr_print_a(virtual_machine_t *state) {
+    char c = (char)state->a;
+    mvm_write(state->context, MVM_OUTPUT, &c, 1);
+}
+
+void mvm_itr_unassigned(virtual_machine_t *state) {
+    state->flags = MINVM_EXCEPTION | MINVM_HALT;
 }
 
@@ -0,0 +1,210 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "minvm_defs.h"
+#include "minvm_context.h"
+#include "minvm_int.h"
+#include "minvm_cfg.h"
+#include "minvm_memo.h"
+
+extern void vm_step(virtual_machine_t *vm);
+
+#define MEMO_UNKNOWN        0
+#define MEMO_CACHEABLE      1
+#define MEMO_UNCACHEABLE    2
+
+static const byte registerMasks[] = { REGA, REGB, REGC, REGD };
+
+memo_t* mvm_memo_create (mvm_context_t *context) {
+    memo_t *memo = (memo_t*)mvm_alloc(context, sizeof(memo_t));
+    if (!memo) {
+        mvm_error(context, "mvm_memo_create: couldn't allocate %u bytes", sizeof(memo_t));
+    }
+    return memo;
+}
+
+void mvm_memo_free (mvm_context_t *context, memo_t *memo) {
+    mvm_free(context, memo);
+}
+
+static void mvm_memo_watch (memo_t *memo, byte address, byte entry) {
+    byte bit = (byte)(1 << (entry & 7));
+    if (!(memo->watchers[address][entry >> 3] & bit)) {
+        memo->watchers[address][entry >> 3] |= bit;
+        memo->watched[address]++;
+    }
+}
+
+// Discards the analysis and cached outputs of the block at entry
+static void mvm_memo_forget (memo_t *memo, byte entry) {
+    byte bit = (byte)(1 << (entry & 7));
+    uint32_t address;
+
+    for (address = 0; address < RAM_SIZE; ++address) {
+        if (memo->watchers[address][entry >> 3] & bit) {
+            memo->watchers[address][entry >> 3] &= ~bit;
+            memo->watched[address]--;
+        }
+    }
+
+    memset(&memo->blocks[entry], 0, sizeof(memo_block_t));
+    if (memo->discarded[entry] < MEMO_UNSTABLE) {
+        memo->discarded[entry]++;
+    }
+    memo->invalidations++;
+}
+
+static void mvm_memo_store (memo_t *memo, byte address) {
+    uint32_t entry;
+
+    for (entry = 0; memo->watched[address] && entry < RAM_SIZE; ++entry) {
+        if (memo->watchers[address][entry >> 3] & (1 << (entry & 7))) {
+            mvm_memo_forget(memo, (byte)entry);
+        }
+    }
+}
+
+static void mvm_memo_analyze (memo_t *memo, const byte *code, byte entry) {
+    memo_block_t *block = &memo->blocks[entry];
+    bool stable = memo->discarded[entry] < MEMO_UNSTABLE;
+    byte pc = entry;
+    uint32_t index;
+
+    for (index = 0; index < MEMO_MAX_INSTRUCTIONS; ++index) {
+        instruction_t ins;
+        byte reads;
+        byte writes;
+        byte word;
+
+        mvm_decode(code, pc, &ins);
+        if (ins.opcode == 0xE0 || ins.opcode == 0xF0 // STOR, ITR
+            || (ins.opcode == 0x00 && ins.argument == 0) // Halt
+            || mvm_instruction_traps(&ins)
+            || (ins.opcode == 0x30 && !stable)) { // LOADR of changing data
+            break;
+        }
+
+        mvm_register_uses(&ins, &reads, &writes);
+        block->reads |= reads & ~block->writes;
+        block->writes |= writes;
+        block->count++;
+
+        // The cached outputs are only valid while the block's code is unchanged
+        for (word = 0; word < ins.size; ++word) {
+            mvm_memo_watch(memo, (byte)(pc + word), entry);
+        }
+
+        pc = (byte)(pc + ins.size);
+        if (ins.opcode == 0xC0 || ins.opcode == 0xD0) { // JMPNEQ, JMPEQ
+            break;
+        }
+    }
+
+    block->state = (block->count >= MEMO_MIN_INSTRUCTIONS) ? MEMO_CACHEABLE : MEMO_UNCACHEABLE;
+}
+
+static uint32_t mvm_memo_key (const virtual_machine_t *vm, byte reads) {
+    uint32_t key = 0;
+    if (reads & REGA) key |= (uint32_t)vm->a;
+    if (reads & REGB) key |= (uint32_t)vm->b << 8;
+    if (reads & REGC) key |= (uint32_t)vm->c << 16;
+    if (reads & REGD) key |= (uint32_t)vm->d << 24;
+    return key;
+}
+
+static memo_entry_t* mvm_memo_lookup (memo_block_t *block, uint32_t key) {
+    return &block->entries[(key * 2654435761u) >> 26];
+}
+
+// Executes the instruction at the program counter, discarding blocks a STOR changes
+static void mvm_memo_step (memo_t *memo, virtual_machine_t *vm) {
+    instruction_t ins;
+
+    mvm_decode(vm->code, vm->pc, &ins);
+    if (ins.opcode == 0xE0) {
+        byte count = (byte)mvm_count_bits(ins.argument);
+        byte index;
+        for (index = 0; index < count; ++index) {
+            mvm_memo_store(memo, (byte)(ins.operand + index));
+        }
+    }
+
+    vm_step(vm);
+    vm->instructions++;
+    memo->instructions++;
+}
+
+// Executes a block, recording the words its LOADRs read as dependencies
+static void mvm_memo_record (memo_t *memo, virtual_machine_t *vm, memo_block_t *block, byte entry) {
+    byte *registers[NUM_REGISTERS];
+    byte index;
+
+    registers[0] = &vm->a;
+    registers[1] = &vm->b;
+    registers[2] = &vm->c;
+    registers[3] = &vm->d;
+
+    for (index = 0; index < block->count && !(vm->flags & MINVM_HALT); ++index) {
+        if ((vm->code[vm->pc] & 0xF0) == 0x30) { // LOADR
+            byte sourceRegisterMask = vm->code[(byte)(vm->pc + 1)];
+            byte reg;
+            for (reg = 0; reg < NUM_REGISTERS; ++reg) {
+                if (sourceRegisterMask & registerMasks[reg]) {
+                    mvm_memo_watch(memo, *registers[reg], entry);
+                }
+            }
+        }
+
+        vm_step(vm);
+        vm->instructions++;
+        memo->instructions++;
+    }
+}
+
+void mvm_exec_memo (virtual_machine_t *vm, memo_t *memo) {
+    while (!(vm->flags & MINVM_HALT)) {
+        byte entry = vm->pc;
+        memo_block_t *block = &memo->blocks[entry];
+        memo_entry_t *cached;
+        uint32_t key;
+
+        if (block->state == MEMO_UNKNOWN) {
+            mvm_memo_analyze(memo, vm->code, entry);
+        }
+
+        if (block->state != MEMO_CACHEABLE) {
+            mvm_memo_step(memo, vm);
+            continue;
+        }
+
+        key = mvm_memo_key(vm, block->reads);
+        cached = mvm_memo_lookup(block, key);
+
+        if (cached->valid && cached->key == key) {
+            if (block->writes & REGA) vm->a = cached->registers[0];
+            if (block->writes & REGB) vm->b = cached->registers[1];
+            if (block->writes & REGC) vm->c = cached->registers[2];
+            if (block->writes & REGD) vm->d = cached->registers[3];
+            vm->pc = cached->pc;
+            vm->instructions += block->count;
+            memo->instructions += block->count;
+            memo->hits++;
+            continue;
+        }
+
+        memo->misses++;
+        mvm_memo_record(memo, vm, block, entry);
+
+        // Blocks that raise an exception are not cached
+        if (!(vm->flags & MINVM_HALT)) {
+            cached->valid = true;
+            cached->key = key;
+            cached->pc = vm->pc;
+            cached->registers[0] = vm->a;
+            cached->registers[1] = vm->b;
+            cached->registers[2] = vm->c;
+            cached->registers[3] = vm->d;
+        }
+    }
+}
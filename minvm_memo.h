@@ -0,0 +1,55 @@
+#ifndef _included_minvm_memo_h
+#define _included_minvm_memo_h
+
+//
+// Basic block memoization
+//
+// A block starts at any address control reaches and ends after a jump, or
+// before a STOR, ITR, halt or trapping instruction. Such a block is a pure
+// function of the registers it reads before writing them, its own code and
+// any words its LOADRs read. For each block entry the engine caches the
+// outputs of previously seen inputs and skips executing the block on a hit.
+//
+// A STOR to a word a block depends on discards everything cached for it. A
+// block discarded too often reads data the program keeps changing, so once
+// re-analyzed it ends before its first LOADR instead.
+//
+
+#define MEMO_MAX_INSTRUCTIONS   16      // Longest block
+#define MEMO_MIN_INSTRUCTIONS   3       // Shorter blocks are cheaper to execute than look up
+#define MEMO_ENTRIES            64      // Cached inputs per block, direct mapped
+#define MEMO_UNSTABLE           4       // Discards before a block stops at LOADR
+
+typedef struct memo_entry_t {
+    bool        valid;
+    uint32_t    key;                    // Input registers, packed A to D
+    byte        pc;                     // Program counter on exit
+    byte        registers[NUM_REGISTERS];
+} memo_entry_t;
+
+typedef struct memo_block_t {
+    byte        state;                  // MEMO_UNKNOWN, MEMO_CACHEABLE or MEMO_UNCACHEABLE
+    byte        reads;                  // Mask of registers read before being written
+    byte        writes;                 // Mask of registers written
+    byte        count;                  // Instructions in the block
+    memo_entry_t entries[MEMO_ENTRIES];
+} memo_block_t;
+
+typedef struct memo_t {
+    memo_block_t blocks[RAM_SIZE];
+    byte        watchers[RAM_SIZE][RAM_SIZE / 8];   // Per word, set of block entries depending on it
+    uint16_t    watched[RAM_SIZE];                  // Per word, number of blocks depending on it
+    byte        discarded[RAM_SIZE];                // Per block entry, times its cache was discarded
+
+    // Statistics
+    uint64_t    instructions;           // Instructions executed or skipped
+    uint64_t    hits;
+    uint64_t    misses;
+    uint64_t    invalidations;
+} memo_t;
+
+memo_t*     mvm_memo_create (mvm_context_t *context);
+void        mvm_memo_free (mvm_context_t *context, memo_t *memo);
+void        mvm_exec_memo (virtual_machine_t *vm, memo_t *memo);
+
+#endif // _included_minvm_memo_h
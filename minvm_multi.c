@@ -0,0 +1,184 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "minvm_defs.h"
+#include "minvm_context.h"
+#include "minvm_int.h"
+#include "minvm_multi.h"
+
+extern void vm_exec(virtual_machine_t *vm);
+extern void vm_step(virtual_machine_t *vm);
+
+static void mvm_cores_release (mvm_cores_t *machine) {
+    uint32_t i;
+
+    machine->arrived = 0;
+    machine->generation++;
+
+    if (machine->replay) {
+        for (i = 0; i < machine->count; ++i) {
+            machine->cores[i].waiting = false;
+        }
+    } else {
+        mvm_cond_broadcast(&machine->released);
+    }
+}
+
+static void itr_core_id (virtual_machine_t *state) {
+    mvm_core_t *core = (mvm_core_t*)state;
+    state->a = (byte)core->id;
+    state->b = (byte)core->machine->count;
+}
+
+static void itr_barrier (virtual_machine_t *state) {
+    mvm_core_t *core = (mvm_core_t*)state;
+    mvm_cores_t *machine = core->machine;
+    uint32_t generation;
+
+    if (machine->replay) {
+        // Park the core, the scheduler skips it until the barrier releases
+        core->waiting = true;
+        if (++machine->arrived == machine->running) {
+            mvm_cores_release(machine);
+        }
+        return;
+    }
+
+    mvm_mutex_lock(&machine->lock);
+    generation = machine->generation;
+    if (++machine->arrived == machine->running) {
+        mvm_cores_release(machine);
+    } else {
+        while (generation == machine->generation) {
+            mvm_cond_wait(&machine->released, &machine->lock);
+        }
+    }
+    mvm_mutex_unlock(&machine->lock);
+}
+
+// A halted core leaves the barrier group so the remaining cores can't deadlock on it
+static void mvm_cores_retire (mvm_cores_t *machine) {
+    if (!machine->replay) {
+        mvm_mutex_lock(&machine->lock);
+    }
+
+    machine->running--;
+    if (machine->arrived > 0 && machine->arrived == machine->running) {
+        mvm_cores_release(machine);
+    }
+
+    if (!machine->replay) {
+        mvm_mutex_unlock(&machine->lock);
+    }
+}
+
+static void mvm_core_thread (void *arg) {
+    mvm_core_t *core = (mvm_core_t*)arg;
+    vm_exec(&core->vm);
+    mvm_cores_retire(core->machine);
+}
+
+static void mvm_cores_replay (mvm_cores_t *machine) {
+    uint32_t i;
+
+    while (machine->running > 0) {
+        for (i = 0; i < machine->count; ++i) {
+            mvm_core_t *core = &machine->cores[i];
+            if ((core->vm.flags & MINVM_HALT) || core->waiting) {
+                continue;
+            }
+
+            vm_step(&core->vm);
+            if (core->vm.flags & MINVM_HALT) {
+                mvm_cores_retire(machine);
+            }
+        }
+    }
+}
+
+static bool mvm_cores_parallel (mvm_cores_t *machine) {
+    mvm_thread_t *threads;
+    uint32_t started;
+    uint32_t i;
+
+    threads = (mvm_thread_t*)mvm_alloc(machine->context, machine->count * sizeof(mvm_thread_t));
+    if (!threads) {
+        mvm_error(machine->context, "mvm_cores_run: couldn't allocate %u threads", machine->count);
+        return false;
+    }
+
+    for (started = 0; started < machine->count; ++started) {
+        if (!mvm_thread_start(&threads[started], mvm_core_thread, &machine->cores[started])) {
+            mvm_error(machine->context, "mvm_cores_run: couldn't start thread for core %u", started);
+            break;
+        }
+    }
+
+    // Cores that never started are retired so the started ones can pass barriers
+    for (i = started; i < machine->count; ++i) {
+        machine->cores[i].vm.flags = MINVM_EXCEPTION | MINVM_HALT;
+        mvm_cores_retire(machine);
+    }
+
+    for (i = 0; i < started; ++i) {
+        mvm_thread_join(&threads[i]);
+    }
+
+    mvm_free(machine->context, threads);
+    return started == machine->count;
+}
+
+bool mvm_cores_run (mvm_context_t *context, mvm_cores_t *machine, byte *ram, uint32_t count, bool replay) {
+    uint32_t i;
+    bool status;
+
+    memset(machine, 0, sizeof(*machine));
+    machine->context = context;
+
+    if (count == 0 || count > MAX_CORES) {
+        mvm_error(context, "mvm_cores_run: core count %u outside 1..%u", count, MAX_CORES);
+        return false;
+    }
+
+    machine->cores = (mvm_core_t*)mvm_alloc(context, count * sizeof(mvm_core_t));
+    if (!machine->cores) {
+        mvm_error(context, "mvm_cores_run: couldn't allocate %u cores", count);
+        return false;
+    }
+
+    machine->count = count;
+    machine->running = count;
+    machine->replay = replay;
+
+    memcpy(machine->interrupts, context->interrupts, sizeof(machine->interrupts));
+    machine->interrupts[ITR_CORE_ID] = itr_core_id;
+    machine->interrupts[ITR_BARRIER] = itr_barrier;
+
+    for (i = 0; i < count; ++i) {
+        machine->cores[i].id = i;
+        machine->cores[i].machine = machine;
+        machine->cores[i].vm.interrupts = machine->interrupts;
+        machine->cores[i].vm.code = ram;
+        machine->cores[i].vm.context = context;
+    }
+
+    if (replay) {
+        mvm_cores_replay(machine);
+        return true;
+    }
+
+    mvm_mutex_init(&machine->lock);
+    mvm_cond_init(&machine->released);
+    status = mvm_cores_parallel(machine);
+    mvm_cond_destroy(&machine->released);
+    mvm_mutex_destroy(&machine->lock);
+
+    return status;
+}
+
+void mvm_cores_free (mvm_cores_t *machine) {
+    mvm_free(machine->context, machine->cores);
+    machine->cores = NULL;
+    machine->count = 0;
+}
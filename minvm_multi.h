@@ -0,0 +1,61 @@
+#ifndef _included_minvm_multi_h
+#define _included_minvm_multi_h
+
+#include "minvm_thread.h"
+
+//
+// Multi-core guest mode
+//
+// N cores share one RAM image. Every core starts at address 0 with its own
+// program counter, flags and registers and runs on its own host thread, or
+// all cores are interleaved on the calling thread in replay mode.
+//
+// Memory model:
+//
+// - Instruction fetch, LOADR and STOR access each word with a single relaxed
+//   atomic byte load or store, see LOAD_WORD in minvm_defs.h, so a word is
+//   never observed partially written and concurrent accesses don't race
+// - A STOR of several registers is a sequence of single word stores, other
+//   cores may observe any prefix of it
+// - Outside of the barrier there is no ordering between cores
+// - The barrier orders all memory accesses made before it on every core
+//   before all accesses made after it on any core
+//
+// Replay mode executes one instruction on each running core in core order,
+// then repeats. A program that only communicates across barriers produces the
+// same final state in replay and parallel mode.
+//
+
+#define ITR_CORE_ID       2       // A = core id, B = number of cores
+#define ITR_BARRIER       3       // Wait until every running core reaches a barrier
+
+#define MAX_CORES         64
+
+typedef struct mvm_cores_t mvm_cores_t;
+
+typedef struct mvm_core_t {
+    virtual_machine_t   vm;             // First member, interrupts receive a pointer to it
+    uint32_t            id;
+    bool                waiting;        // Parked at the barrier in replay mode
+    mvm_cores_t         *machine;
+} mvm_core_t;
+
+struct mvm_cores_t {
+    mvm_context_t       *context;
+    mvm_core_t          *cores;
+    uint32_t            count;
+    bool                replay;
+    interrupt_function_t interrupts[16];
+
+    // Barrier state, the lock is only used in parallel mode
+    mvm_mutex_t         lock;
+    mvm_cond_t          released;
+    uint32_t            running;        // Cores that have not halted
+    uint32_t            arrived;        // Running cores waiting at the barrier
+    uint32_t            generation;     // Incremented each time the barrier releases
+};
+
+bool        mvm_cores_run (mvm_context_t *context, mvm_cores_t *machine, byte *ram, uint32_t count, bool replay);
+void        mvm_cores_free (mvm_cores_t *machine);
+
+#endif // _included_minvm_multi_h
@@ -0,0 +1,1069 @@
+//
+// vmopt: offline bytecode optimizer
+//
+//   ./vmopt <input.bin> <output.bin>
+//
+// Rewrites a program into an equivalent one that executes fewer instructions:
+//
+// - Jump threading: jumps to unconditional jumps, or to conditional jumps
+//   on the same registers, are sent to the final destination
+// - Peephole: ROTR of fewer than two registers, rotations that cancel out,
+//   INC, DEC and STOR without registers and jumps to the next instruction
+//   are removed
+// - Dead code: instructions whose results are never read are removed, and
+//   LOADI drops the registers that are never read
+// - Arithmetic folding: a run of INC, DEC, and ADD or SUB of a known value
+//   that all update one register becomes a single ADD from a register
+//   already holding the total, or is removed when the total is zero. A run
+//   of MUL by known values becomes a single MUL the same way. When code is
+//   compacted, consecutive AND, OR or XOR of the same sources become one
+//   instruction writing both targets
+//
+// Other runs can't be folded into one instruction of this instruction set.
+// INC and DEC of several registers count them as one wide number, but ADD
+// and MUL only read two single words and spread the result, at most 16 bits,
+// over their targets, so nothing adds a constant to a wide number. For the
+// same reason ADD, SUB or MUL of the same sources into two registers can't
+// share an instruction, the second target would receive the carry or high
+// byte instead of a copy. A total that no register holds would need a LOADI
+// as well, which saves nothing over the two instructions it replaces.
+//
+// Only programs mvm_verify() proves safe are rewritten, so the code never
+// changes while running. Words that are not reachable instructions are never
+// moved or modified, so STOR and LOADR addresses stay valid as long as they
+// don't point into code.
+//
+// Removed instructions are compacted away when the program is relocatable:
+// every LOADR reads a constant address outside of the code and no ITR 0
+// dumps the program counter. Jump targets and the halt address are remapped
+// and the freed words are zeroed. Otherwise the layout is kept, runs of
+// removed instructions are replaced by a single jump over them and the final
+// program counter is unchanged.
+//
+// Both images are run before the output is written, and the optimized image
+// must produce the same flags, registers, non-code memory and interrupt
+// output as the original, and halt at the remapped address of the original's
+// final program counter. A program that doesn't halt within CHECK_LIMIT
+// instructions can't be checked and is written out unchanged.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "minvm.h"
+
+#define ALL_REGISTERS     (REGA | REGB | REGC | REGD)
+#define CHECK_LIMIT       100000000     // Instructions run when checking the result
+#define OUTPUT_SZ         4096          // Interrupt output compared when checking
+
+static const byte registerMasks[] = { REGA, REGB, REGC, REGD };
+
+typedef struct opt_ins_t {
+    instruction_t   ins;                // Rewritten by the passes, pc is the original address
+    byte            span;               // Words used in the original layout
+    byte            immediates[NUM_REGISTERS]; // LOADI values, indexed by register
+    bool            deleted;
+    bool            folded;             // Deleted into an earlier instruction, must not run in place
+    byte            live_in;            // Registers read before written from here on
+    byte            live_out;
+    byte            moved;              // Address after relocation
+} opt_ins_t;
+
+typedef struct opt_program_t {
+    byte            image[RAM_SIZE];
+    verify_report_t report;             // Control-flow graph of the original program
+    opt_ins_t       *at[RAM_SIZE];      // Instruction starting at each original address
+    opt_ins_t       list[RAM_SIZE];     // Reachable instructions in address order
+    uint32_t        count;
+    bool            relocatable;
+    char            pinned[MESSAGE_SZ]; // Why the program can't be relocated
+
+    // Statistics
+    uint32_t        threaded;
+    uint32_t        folded;             // Instructions merged into an earlier one
+    uint32_t        removed;            // Instructions dropped from the emitted image
+    uint32_t        bridged;            // Jumps and INC without registers emitted over removed instructions
+    uint32_t        narrowed;
+} opt_program_t;
+
+typedef struct opt_run_t {
+    virtual_machine_t vm;               // First member, interrupts receive a pointer to it
+    byte            ram[RAM_SIZE];
+    char            output[OUTPUT_SZ];
+    uint32_t        output_size;
+    bool            halted;
+} opt_run_t;
+
+static bool is_jump (const instruction_t *ins) {
+    return ins->opcode == 0xC0 || ins->opcode == 0xD0;
+}
+
+static bool is_halt (const instruction_t *ins) {
+    return ins->opcode == 0x00 && ins->argument == 0;
+}
+
+static byte fallthrough (const opt_ins_t *op) {
+    return (byte)(op->ins.pc + op->span);
+}
+
+// Successors of an instruction in the original layout, removed instructions fall through
+static byte opt_successors (const opt_ins_t *op, byte next[2]) {
+    instruction_t ins = op->ins;
+
+    if (op->deleted) {
+        next[0] = fallthrough(op);
+        return 1;
+    }
+
+    ins.size = op->span;
+    return mvm_successors(&ins, next);
+}
+
+static bool opt_pin (opt_program_t *program, cchar *fmt, ...) {
+    va_list ap;
+
+    if (program->relocatable) {
+        va_start(ap, fmt);
+        mvm_vprint_string(program->pinned, sizeof(program->pinned), fmt, ap);
+        va_end(ap);
+        program->relocatable = false;
+    }
+    return false;
+}
+
+static bool opt_load (mvm_context_t *context, opt_program_t *program, cchar *filename) {
+    buffer_t buffer;
+    uint32_t pc;
+
+    memset(program, 0, sizeof(*program));
+
+    if (!mvm_read_buffer_ram(context, filename, &buffer)) {
+        return false;
+    }
+    memcpy(program->image, buffer.data, RAM_SIZE);
+    if (!mvm_free_buffer(context, &buffer)) {
+        return false;
+    }
+
+    if (!mvm_verify(program->image, &program->report)) {
+        return true;
+    }
+
+    for (pc = 0; pc < RAM_SIZE; ++pc) {
+        opt_ins_t *op;
+        byte reg;
+        byte next;
+
+        if (!(program->report.cfg.flags[pc] & CFG_ENTRY)) {
+            continue;
+        }
+
+        op = &program->list[program->count++];
+        program->at[pc] = op;
+        mvm_decode(program->image, (byte)pc, &op->ins);
+        op->span = op->ins.size;
+
+        if (op->ins.opcode == 0x00) {
+            next = (byte)(pc + 1);
+            for (reg = 0; reg < NUM_REGISTERS; ++reg) {
+                if (op->ins.argument & registerMasks[reg]) {
+                    op->immediates[reg] = program->image[next++];
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+//
+// Relocation safety
+//
+
+// Constant propagation of the registers at each instruction, used to find the addresses LOADR reads
+typedef struct opt_constants_t {
+    bool            visited;
+    byte            known;              // Mask of registers with a known value
+    byte            values[NUM_REGISTERS];
+} opt_constants_t;
+
+static bool opt_merge (opt_constants_t *into, const opt_constants_t *from) {
+    byte known;
+    byte reg;
+
+    if (!into->visited) {
+        *into = *from;
+        into->visited = true;
+        return true;
+    }
+
+    known = into->known & from->known;
+    for (reg = 0; reg < NUM_REGISTERS; ++reg) {
+        if (into->values[reg] != from->values[reg]) {
+            known &= ~registerMasks[reg];
+        }
+    }
+
+    if (known == into->known) {
+        return false;
+    }
+    into->known = known;
+    return true;
+}
+
+static byte opt_encode (const opt_ins_t *op, byte *out);
+
+// Executes an instruction as rewritten on known register values, registers it writes from unknown
+// inputs become unknown. A deleted instruction may still run in place unless it was folded
+static void opt_transfer (const opt_program_t *program, const opt_ins_t *op, opt_constants_t *state) {
+    const instruction_t *ins = &op->ins;
+    byte ram[RAM_SIZE];
+    byte words[1 + NUM_REGISTERS];
+    byte size;
+    virtual_machine_t vm;
+    byte *registers[NUM_REGISTERS];
+    byte reads;
+    byte writes;
+    byte reg;
+
+    if (op->folded) {
+        return;
+    }
+
+    if (ins->opcode == 0xF0) { // The handler may change any register
+        state->known = 0;
+        return;
+    }
+
+    mvm_register_uses(ins, &reads, &writes);
+    if (writes == 0) {
+        return;
+    }
+
+    if (op->deleted || (reads & ~state->known) || ins->opcode == 0x30) { // LOADR reads memory
+        state->known &= ~writes;
+        return;
+    }
+
+    memcpy(ram, program->image, RAM_SIZE);
+    size = opt_encode(op, words);
+    for (reg = 0; reg < size; ++reg) {
+        ram[(byte)(ins->pc + reg)] = words[reg];
+    }
+    memset(&vm, 0, sizeof(vm));
+    vm.code = ram;
+    vm.pc = ins->pc;
+    vm.a = state->values[0];
+    vm.b = state->values[1];
+    vm.c = state->values[2];
+    vm.d = state->values[3];
+    vm_step(&vm);
+
+    if (vm.flags & MINVM_EXCEPTION) { // Division by zero, execution doesn't continue
+        state->known &= ~writes;
+        return;
+    }
+
+    registers[0] = &vm.a;
+    registers[1] = &vm.b;
+    registers[2] = &vm.c;
+    registers[3] = &vm.d;
+    for (reg = 0; reg < NUM_REGISTERS; ++reg) {
+        if (writes & registerMasks[reg]) {
+            state->values[reg] = *registers[reg];
+        }
+    }
+    state->known |= writes;
+}
+
+// Known register values on entry to every instruction, NULL when out of memory
+static opt_constants_t* opt_constants (const opt_program_t *program) {
+    opt_constants_t *states;
+    byte pending[RAM_SIZE];
+    bool queued[RAM_SIZE];
+    uint32_t top = 0;
+
+    states = (opt_constants_t*)calloc(RAM_SIZE, sizeof(opt_constants_t));
+    if (!states) {
+        return NULL;
+    }
+
+    // All registers start at zero
+    memset(queued, 0, sizeof(queued));
+    states[0].visited = true;
+    states[0].known = ALL_REGISTERS;
+    pending[top++] = 0;
+    queued[0] = true;
+
+    while (top > 0) {
+        const opt_ins_t *op = program->at[pending[--top]];
+        opt_constants_t state = states[op->ins.pc];
+        byte next[2];
+        byte count;
+        byte index;
+
+        queued[op->ins.pc] = false;
+        opt_transfer(program, op, &state);
+
+        count = opt_successors(op, next);
+        for (index = 0; index < count; ++index) {
+            if (opt_merge(&states[next[index]], &state) && !queued[next[index]]) {
+                queued[next[index]] = true;
+                pending[top++] = next[index];
+            }
+        }
+    }
+
+    return states;
+}
+
+static void opt_check_relocatable (opt_program_t *program) {
+    opt_constants_t *states;
+    uint32_t i;
+
+    program->relocatable = true;
+
+    if (program->report.cfg.flags[RAM_SIZE - 1] & CFG_CODE) {
+        opt_pin(program, "code reaches the end of memory");
+    }
+
+    // Instructions decoded inside the operands of another
+    for (i = 0; i < program->count; ++i) {
+        const opt_ins_t *op = &program->list[i];
+        byte word;
+        for (word = 1; word < op->ins.size; ++word) {
+            if (program->at[(byte)(op->ins.pc + word)]) {
+                opt_pin(program, "instruction at 0x%02x overlaps 0x%02x", op->ins.pc, (byte)(op->ins.pc + word));
+            }
+        }
+        if (op->ins.opcode == 0xF0 && op->ins.argument == 0) {
+            opt_pin(program, "ITR 0 at 0x%02x prints the program counter", op->ins.pc);
+        }
+    }
+
+    if (!program->relocatable) {
+        return;
+    }
+
+    states = opt_constants(program);
+    if (!states) {
+        opt_pin(program, "out of memory");
+        return;
+    }
+
+    for (i = 0; i < program->count; ++i) {
+        const opt_ins_t *op = &program->list[i];
+        const opt_constants_t *state = &states[op->ins.pc];
+        byte reg;
+
+        if (op->ins.opcode != 0x30) {
+            continue;
+        }
+
+        for (reg = 0; reg < NUM_REGISTERS; ++reg) {
+            if (!(op->ins.operand & registerMasks[reg])) {
+                continue;
+            }
+            if (!(state->known & registerMasks[reg])) {
+                opt_pin(program, "LOADR at 0x%02x reads a computed address", op->ins.pc);
+            } else if (program->report.cfg.flags[state->values[reg]] & CFG_CODE) {
+                opt_pin(program, "LOADR at 0x%02x reads code at 0x%02x", op->ins.pc, state->values[reg]);
+            }
+        }
+    }
+
+    free(states);
+}
+
+//
+// Passes
+//
+
+// Follows a taken jump through the jumps it lands on
+static byte opt_thread_target (const opt_program_t *program, const opt_ins_t *jump) {
+    byte target = jump->ins.operand;
+    uint32_t hops;
+
+    for (hops = 0; hops < RAM_SIZE; ++hops) {
+        const opt_ins_t *next = program->at[target];
+
+        if (!next || next->deleted || !is_jump(&next->ins) || next == jump) {
+            break;
+        }
+
+        if (next->ins.argument == 0) {
+            target = next->ins.operand; // Unconditional
+        } else if (next->ins.argument == jump->ins.argument && jump->ins.argument != 0) {
+            // The registers are unchanged, so the condition that held for the first jump decides the second
+            target = (next->ins.opcode == jump->ins.opcode) ? next->ins.operand : fallthrough(next);
+        } else {
+            break;
+        }
+    }
+
+    return target;
+}
+
+static bool opt_thread_jumps (opt_program_t *program) {
+    bool changed = false;
+    uint32_t i;
+
+    for (i = 0; i < program->count; ++i) {
+        opt_ins_t *op = &program->list[i];
+        byte target;
+
+        if (op->deleted || !is_jump(&op->ins)) {
+            continue;
+        }
+
+        target = opt_thread_target(program, op);
+        if (target != op->ins.operand) {
+            op->ins.operand = target;
+            program->threaded++;
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
+static void opt_delete (opt_program_t *program, opt_ins_t *op) {
+    op->deleted = true;
+}
+
+static void opt_fold_into (opt_program_t *program, opt_ins_t *op) {
+    op->deleted = true;
+    op->folded = true;
+    program->folded++;
+}
+
+// The value an instruction adds to reg, or multiplies it by for MUL, when its other source is known
+static bool opt_step (const opt_ins_t *op, byte reg, byte kind, const opt_constants_t *state, byte *value) {
+    byte other = (byte)(op->ins.operand & ~reg);
+    byte index;
+
+    if (op->deleted || op->ins.argument != reg) {
+        return false;
+    }
+
+    if (kind == 0x40) {
+        if (op->ins.opcode == 0x10) { // INC
+            *value = 1;
+            return true;
+        }
+        if (op->ins.opcode == 0x20) { // DEC
+            *value = 0xFF;
+            return true;
+        }
+    }
+
+    // ADD, SUB or MUL of the register and one known register. SUB subtracts the later register
+    if (!(op->ins.operand & reg) || !(state->known & other)
+        || (op->ins.opcode != kind && (kind != 0x40 || op->ins.opcode != 0x50 || other < reg))) {
+        return false;
+    }
+
+    for (index = 0; registerMasks[index] != other; ++index) {
+    }
+    *value = (op->ins.opcode == 0x50) ? (byte)(0 - state->values[index]) : state->values[index];
+    return true;
+}
+
+// Folds a run of steps on one register, starting at op, into op
+static bool opt_fold (opt_program_t *program, opt_ins_t *op, const opt_constants_t *state) {
+    opt_ins_t *run[RAM_SIZE];
+    uint32_t length = 0;
+    byte reg = op->ins.argument;
+    byte kind = (op->ins.opcode == 0x60) ? 0x60 : 0x40;
+    byte total = (kind == 0x60) ? 1 : 0;
+    byte value;
+    byte index;
+    opt_ins_t *next = op;
+
+    if (mvm_count_bits(reg) != 1 || !state->visited) {
+        return false;
+    }
+
+    while (next && opt_step(next, reg, kind, state, &value)
+        && (length == 0 || !(program->report.cfg.flags[next->ins.pc] & CFG_TARGET))) {
+        total = (kind == 0x60) ? (byte)(total * value) : (byte)(total + value);
+        run[length++] = next;
+        next = program->at[fallthrough(next)];
+    }
+
+    if (length < 2) {
+        return false;
+    }
+
+    if (total == ((kind == 0x60) ? 1 : 0)) {
+        while (length > 0) {
+            opt_fold_into(program, run[--length]);
+        }
+        return true;
+    }
+
+    for (index = 0; index < NUM_REGISTERS; ++index) {
+        if (registerMasks[index] != reg && (state->known & registerMasks[index]) && state->values[index] == total) {
+            break;
+        }
+    }
+    if (index == NUM_REGISTERS) {
+        return false;
+    }
+
+    op->ins.opcode = kind;
+    op->ins.operand = reg | registerMasks[index];
+    op->ins.size = 2;
+    while (length > 1) {
+        opt_fold_into(program, run[--length]);
+    }
+    return true;
+}
+
+// Consecutive AND, OR or XOR of the same sources compute the same value when the first doesn't
+// write a source. Only done when compacting, in place the merged one would have to be jumped over
+static bool opt_merge_logic (opt_program_t *program, opt_ins_t *op) {
+    opt_ins_t *next = program->at[fallthrough(op)];
+    bool changed = false;
+
+    while (program->relocatable && next && !next->deleted && next->ins.opcode == op->ins.opcode
+        && next->ins.operand == op->ins.operand && !(op->ins.argument & op->ins.operand)
+        && !(program->report.cfg.flags[next->ins.pc] & CFG_TARGET)) {
+        op->ins.argument |= next->ins.argument;
+        opt_fold_into(program, next);
+        changed = true;
+        next = program->at[fallthrough(next)];
+    }
+
+    return changed;
+}
+
+static bool opt_peephole (opt_program_t *program) {
+    opt_constants_t *states = opt_constants(program);
+    bool changed = false;
+    uint32_t i;
+
+    for (i = 0; i < program->count; ++i) {
+        opt_ins_t *op = &program->list[i];
+        byte registers = (byte)mvm_count_bits(op->ins.argument);
+
+        if (op->deleted) {
+            continue;
+        }
+
+        switch (op->ins.opcode) {
+            case 0x10: case 0x20: case 0xE0: // INC, DEC and STOR without registers
+                if (registers == 0) {
+                    opt_delete(program, op);
+                    changed = true;
+                } else if (op->ins.opcode != 0xE0 && states && opt_fold(program, op, &states[op->ins.pc])) {
+                    changed = true;
+                }
+                break;
+
+            case 0x40: case 0x50: case 0x60: // ADD, SUB and MUL of a known value
+                if (states && opt_fold(program, op, &states[op->ins.pc])) {
+                    changed = true;
+                }
+                break;
+
+            case 0x80: case 0x90: case 0xA0: // AND, OR and XOR of the same sources
+                changed = opt_merge_logic(program, op) || changed;
+                break;
+
+            case 0xC0: case 0xD0: // Jump to the next instruction
+                if (op->ins.operand == fallthrough(op)) {
+                    opt_delete(program, op);
+                    changed = true;
+                }
+                break;
+
+            case 0xB0: { // ROTR, a run of n rotations of n registers cancels out
+                opt_ins_t *run[RAM_SIZE];
+                uint32_t length = 0;
+                uint32_t keep;
+                opt_ins_t *next = op;
+
+                while (next && !next->deleted && next->ins.opcode == 0xB0 && next->ins.argument == op->ins.argument
+                    && (length == 0 || !(program->report.cfg.flags[next->ins.pc] & CFG_TARGET))) {
+                    run[length++] = next;
+                    next = program->at[fallthrough(next)];
+                }
+
+                // Only the whole run cancels out, none of it may run in place
+                keep = (registers < 2) ? 0 : length % registers;
+                while (length > keep) {
+                    opt_delete(program, run[--length]);
+                    run[length]->folded = registers >= 2;
+                    changed = true;
+                }
+                break;
+            }
+        }
+    }
+
+    free(states);
+    return changed;
+}
+
+static void opt_liveness (opt_program_t *program) {
+    bool changed = true;
+    uint32_t i;
+
+    for (i = 0; i < program->count; ++i) {
+        program->list[i].live_in = 0;
+        program->list[i].live_out = 0;
+    }
+
+    while (changed) {
+        changed = false;
+
+        for (i = program->count; i-- > 0;) {
+            opt_ins_t *op = &program->list[i];
+            byte next[2];
+            byte count;
+            byte index;
+            byte live_out = 0;
+            byte live_in;
+            byte reads;
+            byte writes;
+
+            count = opt_successors(op, next);
+            for (index = 0; index < count; ++index) {
+                live_out |= program->at[next[index]]->live_in;
+            }
+
+            if (op->deleted) {
+                live_in = live_out;
+            } else if (is_halt(&op->ins) || op->ins.opcode == 0x70) {
+                live_in = ALL_REGISTERS; // The registers are the final state, DIV may halt
+            } else {
+                mvm_register_uses(&op->ins, &reads, &writes);
+                live_in = reads | (live_out & ~writes);
+            }
+
+            if (live_in != op->live_in || live_out != op->live_out) {
+                op->live_in = live_in;
+                op->live_out = live_out;
+                changed = true;
+            }
+        }
+    }
+}
+
+static bool opt_dead_code (opt_program_t *program) {
+    bool changed = false;
+    uint32_t i;
+
+    opt_liveness(program);
+
+    for (i = 0; i < program->count; ++i) {
+        opt_ins_t *op = &program->list[i];
+        byte reads;
+        byte writes;
+
+        if (op->deleted || is_halt(&op->ins)) {
+            continue;
+        }
+
+        switch (op->ins.opcode) {
+            case 0x00: case 0x10: case 0x20: case 0x30: case 0x40: // LOADI, INC, DEC, LOADR, ADD
+            case 0x50: case 0x60: case 0x80: case 0x90: case 0xA0: case 0xB0: // SUB, MUL, AND, OR, XOR, ROTR
+                break;
+            default:
+                continue;
+        }
+
+        mvm_register_uses(&op->ins, &reads, &writes);
+        if (!(writes & op->live_out)) {
+            opt_delete(program, op);
+            changed = true;
+        } else if (op->ins.opcode == 0x00 && (writes & ~op->live_out) && program->relocatable) {
+            op->ins.argument &= op->live_out;
+            op->ins.size = (byte)(1 + mvm_count_bits(op->ins.argument));
+            program->narrowed++;
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
+// Removes instructions that are no longer reachable after threading
+static void opt_unreachable (opt_program_t *program) {
+    bool reached[RAM_SIZE];
+    byte pending[RAM_SIZE];
+    uint32_t top = 0;
+    uint32_t i;
+
+    memset(reached, 0, sizeof(reached));
+    reached[0] = true;
+    pending[top++] = 0;
+
+    while (top > 0) {
+        const opt_ins_t *op = program->at[pending[--top]];
+        byte next[2];
+        byte count;
+        byte index;
+
+        count = opt_successors(op, next);
+        for (index = 0; index < count; ++index) {
+            if (!reached[next[index]]) {
+                reached[next[index]] = true;
+                pending[top++] = next[index];
+            }
+        }
+    }
+
+    for (i = 0; i < program->count; ++i) {
+        if (!program->list[i].deleted && !reached[program->list[i].ins.pc]) {
+            opt_delete(program, &program->list[i]);
+        }
+    }
+}
+
+//
+// Emission
+//
+
+static byte opt_encode (const opt_ins_t *op, byte *out) {
+    byte size = 0;
+    byte reg;
+
+    out[size++] = op->ins.opcode | op->ins.argument;
+    if (op->ins.opcode == 0x00) {
+        for (reg = 0; reg < NUM_REGISTERS; ++reg) {
+            if (op->ins.argument & registerMasks[reg]) {
+                out[size++] = op->immediates[reg];
+            }
+        }
+    } else if (op->ins.size > 1) {
+        out[size++] = op->ins.operand;
+    }
+    return size;
+}
+
+// Compacts each run of contiguous code, deleted instructions map to the next one kept
+static void opt_emit_relocated (opt_program_t *program, byte *out) {
+    uint32_t i;
+    uint32_t j;
+    byte pc = 0;
+
+    memcpy(out, program->image, RAM_SIZE);
+
+    for (i = 0; i < program->count; ++i) {
+        opt_ins_t *op = &program->list[i];
+        if (i == 0 || !(program->report.cfg.flags[(byte)(op->ins.pc - 1)] & CFG_CODE)) {
+            pc = op->ins.pc; // A new run of code starts at its original address
+        }
+        op->moved = pc;
+        if (!op->deleted) {
+            pc = (byte)(pc + op->ins.size);
+        } else {
+            program->removed++;
+        }
+    }
+
+    // Clear the original code, then write the kept instructions at their new addresses
+    for (i = 0; i < RAM_SIZE; ++i) {
+        if (program->report.cfg.flags[i] & CFG_CODE) {
+            out[i] = 0;
+        }
+    }
+
+    for (i = 0; i < program->count; ++i) {
+        opt_ins_t op = program->list[i];
+        byte words[1 + NUM_REGISTERS];
+        byte size;
+
+        if (op.deleted) {
+            continue;
+        }
+        if (is_jump(&op.ins)) {
+            op.ins.operand = program->at[op.ins.operand]->moved;
+        }
+
+        size = opt_encode(&op, words);
+        for (j = 0; j < size; ++j) {
+            out[(byte)(op.moved + j)] = words[j];
+        }
+    }
+}
+
+// Keeps the layout, a run of two or more deleted instructions becomes one jump past it. A single
+// deleted instruction costs as much to jump over as to run, and it has no effect, so it stays
+// unless it was folded into an earlier one. A folded ADD or MUL can grow into the words of the
+// instructions folded into it, the rest of those become a jump, or an INC without registers
+// when only one word is left
+static void opt_emit_in_place (opt_program_t *program, byte *out) {
+    uint32_t covered = 0;       // End of the last instruction when it grew past its own words
+    uint32_t i;
+    uint32_t j;
+
+    memcpy(out, program->image, RAM_SIZE);
+
+    for (i = 0; i < program->count; ++i) {
+        const opt_ins_t *op = &program->list[i];
+        byte words[1 + NUM_REGISTERS];
+        byte size;
+        bool folded = op->folded;
+        uint32_t start;
+        uint32_t end;
+
+        if (!op->deleted) {
+            size = opt_encode(op, words);
+            for (j = 0; j < size; ++j) {
+                out[(byte)(op->ins.pc + j)] = words[j];
+            }
+            covered = (size > op->span) ? op->ins.pc + size : 0;
+            continue;
+        }
+
+        // Extend the run through contiguous deleted instructions that aren't jumped into
+        for (j = i + 1; j < program->count; ++j) {
+            const opt_ins_t *next = &program->list[j];
+            if (!next->deleted || next->ins.pc != fallthrough(&program->list[j - 1])
+                || (program->report.cfg.flags[next->ins.pc] & CFG_TARGET)) {
+                break;
+            }
+            folded = folded || next->folded;
+        }
+
+        if (j - i < 2 && !folded) {
+            continue;
+        }
+
+        start = (covered > op->ins.pc) ? covered : op->ins.pc;
+        end = program->list[j - 1].ins.pc + program->list[j - 1].span;
+        if (end >= start + 2) {
+            out[(byte)start] = 0xD0; // JMPI
+            out[(byte)(start + 1)] = (byte)end;
+            program->bridged++;
+        } else if (end == start + 1) {
+            out[(byte)start] = 0x10; // INC without registers
+            program->bridged++;
+        }
+        program->removed += j - i;
+        i = j - 1;
+    }
+}
+
+//
+// Equivalence check
+//
+
+static void itr_capture_state (virtual_machine_t *state) {
+    opt_run_t *run = (opt_run_t*)state;
+    int n;
+
+    n = mvm_print_string(run->output + run->output_size, OUTPUT_SZ - run->output_size,
+        "PC: %u (Flags: 0x%02x): A: %02x B: %02x C: %02x D: %02x\n",
+        state->pc, state->flags, state->a, state->b, state->c, state->d);
+    if (n > 0 && run->output_size + n < OUTPUT_SZ) {
+        run->output_size += n;
+    }
+}
+
+static void itr_capture_a (virtual_machine_t *state) {
+    opt_run_t *run = (opt_run_t*)state;
+    if (run->output_size < OUTPUT_SZ) {
+        run->output[run->output_size++] = (char)state->a;
+    }
+}
+
+static interrupt_function_t s_capture[16] = {
+    itr_capture_state, itr_capture_a,
+    mvm_itr_unassigned, mvm_itr_unassigned, mvm_itr_unassigned, mvm_itr_unassigned,
+    mvm_itr_unassigned, mvm_itr_unassigned, mvm_itr_unassigned, mvm_itr_unassigned,
+    mvm_itr_unassigned, mvm_itr_unassigned, mvm_itr_unassigned, mvm_itr_unassigned,
+    mvm_itr_unassigned, mvm_itr_unassigned
+};
+
+static void opt_run (opt_run_t *run, const byte *image) {
+    uint32_t steps;
+
+    memset(run, 0, sizeof(*run));
+    memcpy(run->ram, image, RAM_SIZE);
+    run->vm.code = run->ram;
+    run->vm.interrupts = s_capture;
+
+    for (steps = 0; steps < CHECK_LIMIT && !(run->vm.flags & MINVM_HALT); ++steps) {
+        vm_step(&run->vm);
+    }
+    run->halted = (run->vm.flags & MINVM_HALT) != 0;
+}
+
+// Where the final program counter of the original ends up in a relocated image. A machine
+// halts with its program counter inside or just past the instruction that halted it
+static byte opt_remap_pc (const opt_program_t *program, byte pc) {
+    uint32_t i;
+
+    if (!program->relocatable) {
+        return pc;
+    }
+
+    for (i = 0; i < program->count; ++i) {
+        const opt_ins_t *op = &program->list[i];
+        uint32_t offset = (byte)(pc - op->ins.pc);
+        if (!op->deleted && offset > 0 && offset <= op->span) {
+            return (byte)(op->moved + offset);
+        }
+    }
+
+    return pc;
+}
+
+// Sets checked when the original halts and the two runs could be compared, and halt_pc to where it halted
+static bool opt_check (mvm_context_t *context, const opt_program_t *program, const byte *optimized, cchar *filename,
+                       bool *checked, byte *halt_pc) {
+    opt_run_t *before = (opt_run_t*)malloc(sizeof(opt_run_t));
+    opt_run_t *after = (opt_run_t*)malloc(sizeof(opt_run_t));
+    bool same = true;
+    uint32_t i;
+
+    if (!before || !after) {
+        mvm_error(context, "vmopt: out of memory");
+        free(before);
+        free(after);
+        return false;
+    }
+
+    opt_run(before, program->image);
+    opt_run(after, optimized);
+
+    *checked = before->halted;
+    *halt_pc = before->vm.pc;
+    if (before->halted) {
+        same = after->halted
+            && before->vm.flags == after->vm.flags
+            && before->vm.a == after->vm.a && before->vm.b == after->vm.b
+            && before->vm.c == after->vm.c && before->vm.d == after->vm.d
+            && before->output_size == after->output_size
+            && 0 == memcmp(before->output, after->output, before->output_size);
+        if (after->vm.pc != opt_remap_pc(program, before->vm.pc)) {
+            same = false;
+        }
+        for (i = 0; i < RAM_SIZE; ++i) {
+            if (!(program->report.cfg.flags[i] & CFG_CODE) && before->ram[i] != after->ram[i]) {
+                same = false;
+            }
+        }
+        if (!same) {
+            mvm_error(context, "vmopt: %s: optimized program doesn't match the original", filename);
+        }
+    }
+
+    free(before);
+    free(after);
+    return same;
+}
+
+static bool opt_write (mvm_context_t *context, cchar *filename, const byte *image) {
+    file_t f = { 0, };
+    uint32_t size = RAM_SIZE;
+
+    // Memory is zeroed on load, trailing zero words needn't be stored
+    while (size > 0 && image[size - 1] == 0) {
+        size--;
+    }
+
+    if (ERR_OK != mvm_file_open(context, &f, filename, "wb")) {
+        return false;
+    }
+
+    if (size != fwrite(image, 1, size, f.stream)) {
+        mvm_error(context, "vmopt: couldn't write %s", filename);
+        mvm_file_close(&f);
+        return false;
+    }
+
+    mvm_file_close(&f);
+    return true;
+}
+
+static uint32_t opt_code_size (const opt_program_t *program, bool kept) {
+    uint32_t size = 0;
+    uint32_t i;
+    for (i = 0; i < program->count; ++i) {
+        if (!kept) {
+            size += program->list[i].span;
+        } else if (!program->list[i].deleted) {
+            size += program->list[i].ins.size;
+        }
+    }
+    return size;
+}
+
+int main (int argc, char **argv) {
+    opt_program_t *program;
+    byte optimized[RAM_SIZE];
+    mvm_context_t context;
+    bool changed = true;
+    bool checked = false;
+    byte halt_pc = 0;
+    int status = 0;
+
+    if (argc != 3) {
+        printf("usage: ./vmopt <input.bin> <output.bin>\n");
+        return -1;
+    }
+
+    mvm_context_init(&context);
+
+    program = (opt_program_t*)malloc(sizeof(opt_program_t));
+    if (!program || !opt_load(&context, program, argv[1])) {
+        free(program);
+        return -1;
+    }
+
+    if (!program->report.safe) {
+        mvm_info(&context, "vmopt: %s: unchanged, %s", argv[1], program->report.reason);
+        status = opt_write(&context, argv[2], program->image) ? 0 : 1;
+        free(program);
+        return status;
+    }
+
+    opt_check_relocatable(program);
+
+    while (changed) {
+        changed = opt_thread_jumps(program);
+        changed = opt_peephole(program) || changed;
+        changed = opt_dead_code(program) || changed;
+    }
+
+    if (program->relocatable) {
+        opt_unreachable(program);
+        opt_emit_relocated(program, optimized);
+    } else {
+        opt_emit_in_place(program, optimized);
+    }
+
+    if (!opt_check(&context, program, optimized, argv[1], &checked, &halt_pc)) {
+        free(program);
+        return 1;
+    }
+
+    if (!checked) {
+        mvm_info(&context, "vmopt: %s: unchanged, original didn't halt in %u instructions so the result can't be checked",
+            argv[1], CHECK_LIMIT);
+        status = opt_write(&context, argv[2], program->image) ? 0 : 1;
+        free(program);
+        return status;
+    }
+
+    mvm_info(&context, "vmopt: %s: %u jumps threaded, %u instructions folded, %u instructions removed, %u LOADI narrowed, %u -> %u code words",
+        argv[1], program->threaded, program->folded, program->removed, program->narrowed,
+        opt_code_size(program, false), program->relocatable ? opt_code_size(program, true) : opt_code_size(program, false));
+    if (!program->relocatable) {
+        mvm_info(&context, "vmopt: %s: layout kept, %u jumps or no-ops over removed instructions, %s",
+            argv[1], program->bridged, program->pinned);
+    } else if (opt_remap_pc(program, halt_pc) != halt_pc) {
+        mvm_info(&context, "vmopt: %s: halts at 0x%02x instead of 0x%02x", argv[1], opt_remap_pc(program, halt_pc), halt_pc);
+    }
+
+    status = opt_write(&context, argv[2], optimized) ? 0 : 1;
+    free(program);
+    return status;
+}
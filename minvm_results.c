@@ -0,0 +1,204 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "minvm_defs.h"
+#include "minvm_context.h"
+#include "minvm_int.h"
+#include "minvm_results.h"
+
+#define RESULT_JSON_SZ        (RESULT_JSON_NAME_SZ * 6 + 256)    // Worst case escaped name and fields
+#define RESULT_HASH_SZ        17                                  // '#' and 16 hex digits
+#define RESULT_FNV_BASIS      14695981039346656037ull
+#define RESULT_FNV_PRIME      1099511628211ull
+
+static cchar *s_reasons[] = { "halt", "exception" };
+
+bool mvm_results_parse_format (cchar *name, mvm_results_format_t *format) {
+    if (0 == strcmp(name, "jsonl")) {
+        *format = MVM_RESULTS_JSONL;
+    } else if (0 == strcmp(name, "binary")) {
+        *format = MVM_RESULTS_BINARY;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Copies the name a record of at most size - 1 name bytes keeps. A name that doesn't fit is cut
+// before a UTF-8 continuation byte, so no character is split, and ends in the hash of all of it
+size_t mvm_results_name (cchar *name, char *out, size_t size) {
+    size_t length = strlen(name);
+    uint64_t hash = RESULT_FNV_BASIS;
+    size_t keep;
+    size_t i;
+
+    if (length < size) {
+        memcpy(out, name, length + 1);
+        return length;
+    }
+
+    for (i = 0; i < length; ++i) {
+        hash = (hash ^ (byte)name[i]) * RESULT_FNV_PRIME;
+    }
+
+    keep = size - 1 - RESULT_HASH_SZ;
+    while (keep > 0 && ((byte)name[keep] & 0xC0) == 0x80) {
+        keep--;
+    }
+    memcpy(out, name, keep);
+    mvm_print_string(out + keep, (uint32_t)(size - keep), "#%016llx", (unsigned long long)hash);
+    return keep + RESULT_HASH_SZ;
+}
+
+bool mvm_results_open (mvm_context_t *context, mvm_results_t *results, cchar *filename, mvm_results_format_t format) {
+    memset(results, 0, sizeof(*results));
+    results->context = context;
+    results->format = format;
+
+    results->buffer = (byte*)mvm_alloc(context, RESULTS_BUFFER_SZ);
+    if (!results->buffer) {
+        mvm_error(context, "couldn't allocate the results buffer");
+        return false;
+    }
+
+    if (ERR_OK != mvm_file_open(context, &results->file, filename, "wb") || !results->file.stream) {
+        mvm_free(context, results->buffer);
+        results->buffer = NULL;
+        return false;
+    }
+
+    // Records are already batched, each flush is a single write
+    setvbuf(results->file.stream, NULL, _IONBF, 0);
+    return true;
+}
+
+void mvm_result_from_vm (mvm_result_t *result, cchar *name, const virtual_machine_t *vm) {
+    memset(result, 0, sizeof(*result));
+    result->name = name;
+    result->reason = (vm->flags & MINVM_EXCEPTION) ? MVM_EXIT_EXCEPTION : MVM_EXIT_HALT;
+    result->pc = vm->pc;
+    result->flags = vm->flags;
+    result->a = vm->a;
+    result->b = vm->b;
+    result->c = vm->c;
+    result->d = vm->d;
+    result->instructions = vm->instructions;
+}
+
+static void mvm_results_put (byte *out, uint64_t value, uint32_t size) {
+    uint32_t i;
+
+    for (i = 0; i < size; ++i) {
+        out[i] = (byte)(value >> (8 * i));
+    }
+}
+
+static size_t mvm_results_binary (const mvm_result_t *result, byte *out) {
+    memset(out, 0, RESULT_RECORD_SZ);
+    mvm_results_name(result->name, (char*)out, RESULT_NAME_SZ);
+
+    mvm_results_put(out + 64, result->instructions, 8);
+    mvm_results_put(out + 72, result->output_size, 8);
+    mvm_results_put(out + 80, result->pc, 2);
+    out[82] = result->flags;
+    out[83] = (byte)result->reason;
+    out[84] = result->a;
+    out[85] = result->b;
+    out[86] = result->c;
+    out[87] = result->d;
+    out[88] = result->verified ? 1 : 0;
+
+    return RESULT_RECORD_SZ;
+}
+
+// Escapes quotes, backslashes and control characters
+static size_t mvm_results_escape (cchar *text, char *out) {
+    size_t size = 0;
+    uint32_t i;
+
+    for (i = 0; text[i]; ++i) {
+        byte c = (byte)text[i];
+        if (c == '"' || c == '\\') {
+            out[size++] = '\\';
+            out[size++] = (char)c;
+        } else if (c < 0x20) {
+            size += mvm_print_string(out + size, 7, "\\u%04x", c);
+        } else {
+            out[size++] = (char)c;
+        }
+    }
+    out[size] = '\0';
+
+    return size;
+}
+
+static size_t mvm_results_json (const mvm_result_t *result, byte *out) {
+    char name[RESULT_JSON_NAME_SZ];
+    char escaped[RESULT_JSON_NAME_SZ * 6];
+    int n;
+
+    mvm_results_name(result->name, name, sizeof(name));
+    mvm_results_escape(name, escaped);
+    n = mvm_print_string((char*)out, RESULT_JSON_SZ,
+        "{\"name\":\"%s\",\"reason\":\"%s\",\"pc\":%u,\"flags\":%u,\"a\":%u,\"b\":%u,\"c\":%u,\"d\":%u,"
+        "\"instructions\":%llu,\"output_size\":%llu,\"verified\":%s}\n",
+        escaped, s_reasons[result->reason], result->pc, result->flags,
+        result->a, result->b, result->c, result->d,
+        (unsigned long long)result->instructions, (unsigned long long)result->output_size,
+        result->verified ? "true" : "false");
+
+    return (n < 0) ? 0 : (size_t)n;
+}
+
+bool mvm_results_write (mvm_results_t *results, const mvm_result_t *result) {
+    byte record[RESULT_JSON_SZ];
+    size_t size;
+
+    if (results->failed) {
+        return false;
+    }
+
+    if (results->format == MVM_RESULTS_BINARY) {
+        size = mvm_results_binary(result, record);
+    } else {
+        size = mvm_results_json(result, record);
+    }
+
+    if (results->used + size > RESULTS_BUFFER_SZ && !mvm_results_flush(results)) {
+        return false;
+    }
+
+    memcpy(results->buffer + results->used, record, size);
+    results->used += size;
+    return true;
+}
+
+bool mvm_results_flush (mvm_results_t *results) {
+    size_t written;
+
+    if (results->failed || results->used == 0) {
+        return !results->failed;
+    }
+
+    written = fwrite(results->buffer, 1, results->used, results->file.stream);
+    if (written != results->used) {
+        mvm_error(results->context, "mvm_results_flush: write failed %llu != %llu",
+            (unsigned long long)written, (unsigned long long)results->used);
+        results->failed = true;
+        return false;
+    }
+
+    results->used = 0;
+    return true;
+}
+
+bool mvm_results_close (mvm_results_t *results) {
+    bool status = mvm_results_flush(results);
+
+    mvm_file_close(&results->file);
+    mvm_free(results->context, results->buffer);
+    results->buffer = NULL;
+
+    return status;
+}
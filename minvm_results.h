@@ -0,0 +1,80 @@
+#ifndef _included_minvm_results_h
+#define _included_minvm_results_h
+
+//
+// Structured per-program results
+//
+// Writes one record per program run to a file of its own, so results can be
+// parsed without picking them out of the guest output. Records are collected
+// in a large buffer and written out when it fills or the file is closed.
+//
+// Records keep how many bytes the program wrote through interrupts, not the
+// bytes themselves, which still go to the context sink.
+//
+// JSONL, one object per line:
+//
+//   {"name":"samples/loop.bin","reason":"halt","pc":12,"flags":1,"a":255,
+//    "b":2,"c":255,"d":1,"instructions":1023,"output_size":0,"verified":true}
+//
+// Binary, RESULT_RECORD_SZ bytes per record, integers little endian:
+//
+//   0   name, NUL padded
+//   64  instructions, 8 bytes
+//   72  output_size, 8 bytes
+//   80  pc, 2 bytes
+//   82  flags
+//   83  reason, a mvm_exit_t
+//   84  a, b, c, d
+//   88  verified, 0 or 1
+//   89  zero padding
+//
+// Names longer than RESULT_JSON_NAME_SZ - 1 bytes in JSONL, or RESULT_NAME_SZ
+// - 1 bytes in binary, aren't truncated blindly: mvm_results_name() keeps as
+// many whole UTF-8 characters as fit before a '#' and the hex FNV-1a hash of
+// the full name, so distinct long names still get distinct records.
+//
+
+#define RESULT_NAME_SZ        64
+#define RESULT_JSON_NAME_SZ   1024
+#define RESULT_RECORD_SZ      96
+#define RESULTS_BUFFER_SZ     (64 * 1024)
+
+typedef enum mvm_results_format_t {
+    MVM_RESULTS_JSONL,
+    MVM_RESULTS_BINARY
+} mvm_results_format_t;
+
+typedef enum mvm_exit_t {
+    MVM_EXIT_HALT,
+    MVM_EXIT_EXCEPTION
+} mvm_exit_t;
+
+typedef struct mvm_result_t {
+    cchar       *name;
+    mvm_exit_t  reason;
+    address_t   pc;
+    byte        flags;
+    byte        a, b, c, d;
+    uint64_t    instructions;   // Instructions executed
+    uint64_t    output_size;    // Bytes written by interrupts
+    bool        verified;       // Ran without operand checks
+} mvm_result_t;
+
+typedef struct mvm_results_t {
+    mvm_context_t           *context;
+    mvm_results_format_t    format;
+    file_t                  file;
+    byte                    *buffer;
+    size_t                  used;
+    bool                    failed;         // A write failed, later records are dropped
+} mvm_results_t;
+
+bool        mvm_results_parse_format (cchar *name, mvm_results_format_t *format);
+size_t      mvm_results_name (cchar *name, char *out, size_t size);
+bool        mvm_results_open (mvm_context_t *context, mvm_results_t *results, cchar *filename, mvm_results_format_t format);
+void        mvm_result_from_vm (mvm_result_t *result, cchar *name, const virtual_machine_t *vm);
+bool        mvm_results_write (mvm_results_t *results, const mvm_result_t *result);
+bool        mvm_results_flush (mvm_results_t *results);
+bool        mvm_results_close (mvm_results_t *results);
+
+#endif // _included_minvm_results_h
@@ -0,0 +1,829 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "minvm_defs.h"
+#include "minvm_context.h"
+#include "minvm_int.h"
+#include "minvm_thread.h"
+#include "minvm_sweep.h"
+
+extern void vm_step(virtual_machine_t *vm);
+
+#define SWEEP_CHUNK             256         // Variants a worker takes at a time
+#define SWEEP_INTERVAL          256         // Minimum instructions between checkpoints
+#define SWEEP_CHECKPOINTS       32          // Checkpoints a run publishes
+#define SWEEP_TABLE             (1 << 16)   // Converged states remembered
+#define SWEEP_LOCKS             64
+#define SWEEP_TEXT_SZ           1024        // Output printed per distinct output
+#define SWEEP_PRIME             1099511628211ull
+
+// Exit reasons
+#define SWEEP_HALT              0
+#define SWEEP_EXCEPTION         1
+#define SWEEP_LIMIT             2
+#define SWEEP_LOOP              3           // Came back to an earlier checkpoint state
+#define SWEEP_REASONS           4
+
+static cchar *s_reasons[] = { "HALT", "EXCEPTION", "LIMIT", "LOOP" };
+static cchar *s_registers[] = { "a", "b", "c", "d" };
+
+typedef struct sweep_final_t {
+    byte        reason;
+    byte        flags;
+    byte        pc;
+    byte        a, b, c, d;
+    uint64_t    memory;                 // Hash of the final memory
+} sweep_final_t;
+
+// Full machine state at a checkpoint, compared whenever two hashes match
+typedef struct sweep_state_t {
+    byte        registers[6];           // PC, flags, A, B, C and D
+    byte        ram[RAM_SIZE];
+} sweep_state_t;
+
+// A run's result, output is identified by its hash and size
+typedef struct sweep_result_t {
+    sweep_final_t final;
+    uint64_t    output_hash;
+    uint32_t    output_size;
+    uint64_t    steps;
+    bool        converged;
+} sweep_result_t;
+
+// Result of continuing from a checkpoint state
+typedef struct sweep_converged_t {
+    uint64_t    state;                  // Hash of snapshot, 0 when empty
+    sweep_state_t snapshot;
+    sweep_final_t final;
+    uint64_t    output_hash;            // Output produced after the checkpoint
+    uint32_t    output_size;
+    uint64_t    steps;                  // Instructions executed after the checkpoint
+} sweep_converged_t;
+
+typedef struct sweep_checkpoint_t {
+    uint64_t    state;
+    sweep_state_t snapshot;
+    uint64_t    steps;
+    uint64_t    output_hash;
+    uint32_t    output_size;
+} sweep_checkpoint_t;
+
+// Histogram bucket, keyed by final state or by output
+typedef struct sweep_bucket_t {
+    uint64_t    key;                    // 0 when empty
+    uint64_t    count;
+    uint64_t    first;                  // Lowest variant with this key
+    sweep_final_t final;
+    uint32_t    output_size;
+} sweep_bucket_t;
+
+typedef struct sweep_map_t {
+    sweep_bucket_t *buckets;
+    uint64_t    capacity;
+    uint64_t    count;
+} sweep_map_t;
+
+typedef struct sweep_run_t {
+    virtual_machine_t vm;               // First member, interrupts receive a pointer to it
+    byte        ram[RAM_SIZE];
+    uint64_t    output_hash;
+    uint32_t    output_size;
+    char        *text;                  // Captured output, NULL when only hashing
+    uint32_t    text_size;
+} sweep_run_t;
+
+typedef struct sweep_t sweep_t;
+
+typedef struct sweep_worker_t {
+    sweep_t     *sweep;
+    sweep_run_t run;
+    sweep_map_t states;
+    sweep_map_t outputs;
+    uint64_t    reasons[SWEEP_REASONS];
+    uint64_t    converged;
+    uint64_t    steps;
+    bool        failed;
+} sweep_worker_t;
+
+struct sweep_t {
+    mvm_context_t *context;
+    const sweep_spec_t *spec;
+    const byte  *image;
+    uint64_t    variants;
+
+    mvm_mutex_t lock;                   // Guards next
+    uint64_t    next;
+
+    sweep_converged_t *table;
+    mvm_mutex_t locks[SWEEP_LOCKS];     // Stripes of the table
+};
+
+//
+// Specification
+//
+
+void mvm_sweep_init (sweep_spec_t *spec) {
+    memset(spec, 0, sizeof(*spec));
+    spec->limit = 100000000;
+    spec->show = 10;
+}
+
+// Parses "a=1,2,0x10-0x1f" or "@0x40=0-255"
+bool mvm_sweep_parse (mvm_context_t *context, sweep_spec_t *spec, cchar *vary) {
+    sweep_dimension_t *dimension;
+    bool seen[RAM_SIZE];
+    cchar *p = vary;
+    char *end;
+    uint32_t i;
+
+    if (spec->count >= SWEEP_MAX_DIMENSIONS) {
+        mvm_error(context, "-vary: at most %u dimensions", SWEEP_MAX_DIMENSIONS);
+        return false;
+    }
+
+    dimension = &spec->dimensions[spec->count];
+    memset(dimension, 0, sizeof(*dimension));
+    memset(seen, 0, sizeof(seen));
+
+    if (*p == '@') {
+        unsigned long address = strtoul(p + 1, &end, 0);
+        if (end == p + 1 || address >= RAM_SIZE) {
+            mvm_error(context, "-vary: bad address in %s", vary);
+            return false;
+        }
+        dimension->target = SWEEP_MEMORY + (uint32_t)address;
+        p = end;
+    } else if (*p >= 'a' && *p <= 'd') {
+        dimension->target = (uint32_t)(*p - 'a');
+        p++;
+    } else {
+        mvm_error(context, "-vary: expected a register a-d or @address in %s", vary);
+        return false;
+    }
+
+    if (*p++ != '=') {
+        mvm_error(context, "-vary: expected '=' in %s", vary);
+        return false;
+    }
+
+    while (*p) {
+        unsigned long low = strtoul(p, &end, 0);
+        unsigned long high = low;
+
+        if (end == p) {
+            mvm_error(context, "-vary: bad value in %s", vary);
+            return false;
+        }
+        p = end;
+
+        if (*p == '-') {
+            high = strtoul(p + 1, &end, 0);
+            if (end == p + 1) {
+                mvm_error(context, "-vary: bad range in %s", vary);
+                return false;
+            }
+            p = end;
+        }
+
+        if (low > high || high >= RAM_SIZE) {
+            mvm_error(context, "-vary: values must be 0-255 in %s", vary);
+            return false;
+        }
+
+        for (i = low; i <= high; ++i) {
+            if (!seen[i]) {
+                seen[i] = true;
+                dimension->values[dimension->count++] = (byte)i;
+            }
+        }
+
+        if (*p == ',') {
+            p++;
+        } else if (*p) {
+            mvm_error(context, "-vary: unexpected '%c' in %s", *p, vary);
+            return false;
+        }
+    }
+
+    if (dimension->count == 0) {
+        mvm_error(context, "-vary: no values in %s", vary);
+        return false;
+    }
+
+    spec->count++;
+    return true;
+}
+
+//
+// Hashing
+//
+
+static uint64_t mvm_sweep_hash (uint64_t hash, const byte *data, uint32_t size) {
+    uint32_t i;
+    for (i = 0; i < size; ++i) {
+        hash = (hash ^ data[i]) * SWEEP_PRIME;
+    }
+    return hash;
+}
+
+// Copies the machine state into snapshot and returns its hash
+static uint64_t mvm_sweep_state (const virtual_machine_t *vm, sweep_state_t *snapshot) {
+    uint64_t hash;
+
+    snapshot->registers[0] = vm->pc;
+    snapshot->registers[1] = vm->flags;
+    snapshot->registers[2] = vm->a;
+    snapshot->registers[3] = vm->b;
+    snapshot->registers[4] = vm->c;
+    snapshot->registers[5] = vm->d;
+    memcpy(snapshot->ram, vm->code, RAM_SIZE);
+
+    hash = mvm_sweep_hash(14695981039346656037ull, snapshot->registers, sizeof(snapshot->registers));
+    hash = mvm_sweep_hash(hash, snapshot->ram, RAM_SIZE);
+    return hash ? hash : 1;
+}
+
+static uint64_t mvm_sweep_power (uint64_t n) {
+    uint64_t result = 1;
+    uint64_t base = SWEEP_PRIME;
+    while (n) {
+        if (n & 1) {
+            result *= base;
+        }
+        base *= base;
+        n >>= 1;
+    }
+    return result;
+}
+
+// Output is hashed as a polynomial so the hash of a concatenation can be computed from its parts
+static void mvm_sweep_output (sweep_run_t *run, byte value) {
+    run->output_hash = run->output_hash * SWEEP_PRIME + value;
+    run->output_size++;
+    if (run->text && run->text_size < SWEEP_TEXT_SZ) {
+        run->text[run->text_size++] = (char)value;
+    }
+}
+
+static void itr_sweep_state (virtual_machine_t *state) {
+    char line[MESSAGE_SZ];
+    int n;
+    int i;
+
+    n = mvm_print_string(line, sizeof(line), "PC: %u (Flags: 0x%02x): A: %02x B: %02x C: %02x D: %02x\n",
+        state->pc, state->flags, state->a, state->b, state->c, state->d);
+    for (i = 0; i < n; ++i) {
+        mvm_sweep_output((sweep_run_t*)state, (byte)line[i]);
+    }
+}
+
+static void itr_sweep_a (virtual_machine_t *state) {
+    mvm_sweep_output((sweep_run_t*)state, state->a);
+}
+
+static interrupt_function_t s_sweep_interrupts[16] = {
+    itr_sweep_state, itr_sweep_a,
+    mvm_itr_unassigned, mvm_itr_unassigned, mvm_itr_unassigned, mvm_itr_unassigned,
+    mvm_itr_unassigned, mvm_itr_unassigned, mvm_itr_unassigned, mvm_itr_unassigned,
+    mvm_itr_unassigned, mvm_itr_unassigned, mvm_itr_unassigned, mvm_itr_unassigned,
+    mvm_itr_unassigned, mvm_itr_unassigned
+};
+
+//
+// Convergence table
+//
+
+// A hit needs the full state to match, not just the hash
+static bool mvm_sweep_lookup (sweep_t *sweep, uint64_t state, const sweep_state_t *snapshot, sweep_converged_t *found) {
+    uint64_t slot = state & (SWEEP_TABLE - 1);
+    mvm_mutex_t *lock = &sweep->locks[slot % SWEEP_LOCKS];
+    bool hit;
+
+    mvm_mutex_lock(lock);
+    hit = sweep->table[slot].state == state
+        && 0 == memcmp(&sweep->table[slot].snapshot, snapshot, sizeof(*snapshot));
+    if (hit) {
+        *found = sweep->table[slot];
+    }
+    mvm_mutex_unlock(lock);
+
+    return hit;
+}
+
+static void mvm_sweep_publish (sweep_t *sweep, const sweep_converged_t *converged) {
+    uint64_t slot = converged->state & (SWEEP_TABLE - 1);
+    mvm_mutex_t *lock = &sweep->locks[slot % SWEEP_LOCKS];
+
+    mvm_mutex_lock(lock);
+    sweep->table[slot] = *converged;
+    mvm_mutex_unlock(lock);
+}
+
+//
+// Execution
+//
+
+// Splits a variant index into one value per dimension, the last dimension changes fastest
+static void mvm_sweep_values (const sweep_t *sweep, uint64_t variant, byte *values) {
+    uint32_t i;
+    for (i = sweep->spec->count; i-- > 0;) {
+        const sweep_dimension_t *dimension = &sweep->spec->dimensions[i];
+        values[i] = dimension->values[variant % dimension->count];
+        variant /= dimension->count;
+    }
+}
+
+static void mvm_sweep_setup (const sweep_t *sweep, uint64_t variant, sweep_run_t *run) {
+    byte *registers[NUM_REGISTERS];
+    byte values[SWEEP_MAX_DIMENSIONS];
+    uint32_t i;
+
+    memset(&run->vm, 0, sizeof(run->vm));
+    memcpy(run->ram, sweep->image, RAM_SIZE);
+    run->vm.code = run->ram;
+    run->vm.interrupts = s_sweep_interrupts;
+    run->output_hash = 0;
+    run->output_size = 0;
+    run->text_size = 0;
+
+    registers[0] = &run->vm.a;
+    registers[1] = &run->vm.b;
+    registers[2] = &run->vm.c;
+    registers[3] = &run->vm.d;
+
+    mvm_sweep_values(sweep, variant, values);
+    for (i = 0; i < sweep->spec->count; ++i) {
+        uint32_t target = sweep->spec->dimensions[i].target;
+        if (target < SWEEP_MEMORY) {
+            *registers[target] = values[i];
+        } else {
+            run->ram[target - SWEEP_MEMORY] = values[i];
+        }
+    }
+}
+
+static void mvm_sweep_execute (sweep_t *sweep, uint64_t variant, sweep_run_t *run, sweep_result_t *result, bool converge) {
+    sweep_checkpoint_t checkpoints[SWEEP_CHECKPOINTS];
+    sweep_state_t snapshot;
+    sweep_state_t anchored;
+    uint32_t count = 0;
+    uint64_t steps = 0;
+    uint64_t last = 0;
+    uint64_t taken = 0;
+    uint64_t anchor = 0;
+    bool looped = false;
+    virtual_machine_t *vm = &run->vm;
+    sweep_final_t *final = &result->final;
+    uint32_t i;
+
+    mvm_sweep_setup(sweep, variant, run);
+    memset(result, 0, sizeof(*result));
+
+    while (steps < sweep->spec->limit && !(vm->flags & MINVM_HALT)) {
+        byte before = vm->pc;
+        vm_step(vm);
+        steps++;
+
+        if (vm->pc < before && steps - last >= SWEEP_INTERVAL && !(vm->flags & MINVM_HALT)) {
+            sweep_converged_t found;
+            uint64_t state = mvm_sweep_state(vm, &snapshot);
+
+            last = steps;
+            // A continuation past the limit would report a state the run never reaches on its own
+            if (converge && mvm_sweep_lookup(sweep, state, &snapshot, &found) && steps + found.steps <= sweep->spec->limit) {
+                result->final = found.final;
+                result->output_hash = run->output_hash * mvm_sweep_power(found.output_size) + found.output_hash;
+                result->output_size = run->output_size + found.output_size;
+                result->steps = steps + found.steps;
+                result->converged = true;
+                break;
+            }
+
+            // Each checkpoint state determines the next, so a repeat means the run never halts.
+            // The state compared against moves at powers of two to find cycles of any length.
+            if (state == anchor && 0 == memcmp(&snapshot, &anchored, sizeof(snapshot))) {
+                looped = true;
+                break;
+            }
+            if ((taken & (taken - 1)) == 0) {
+                anchor = state;
+                anchored = snapshot;
+            }
+            taken++;
+
+            if (converge && count < SWEEP_CHECKPOINTS) {
+                checkpoints[count].state = state;
+                checkpoints[count].snapshot = snapshot;
+                checkpoints[count].steps = steps;
+                checkpoints[count].output_hash = run->output_hash;
+                checkpoints[count].output_size = run->output_size;
+                count++;
+            }
+        }
+    }
+
+    if (looped) {
+        // Where the loop is noticed depends on the checkpoint it started from, so only the reason is kept,
+        // and the output, cut at that point, isn't counted as a distinct output
+        final->reason = SWEEP_LOOP;
+        result->output_hash = run->output_hash;
+        result->output_size = run->output_size;
+        result->steps = steps;
+    } else if (!result->converged) {
+        final->reason = (vm->flags & MINVM_EXCEPTION) ? SWEEP_EXCEPTION
+                      : (vm->flags & MINVM_HALT) ? SWEEP_HALT : SWEEP_LIMIT;
+        final->flags = vm->flags;
+        final->pc = vm->pc;
+        final->a = vm->a;
+        final->b = vm->b;
+        final->c = vm->c;
+        final->d = vm->d;
+        final->memory = mvm_sweep_hash(14695981039346656037ull, run->ram, RAM_SIZE);
+        result->output_hash = run->output_hash;
+        result->output_size = run->output_size;
+        result->steps = steps;
+    }
+
+    // Where the run went from each checkpoint is only known if it finished. A loop isn't shared either,
+    // a run taking it would end where this one noticed the loop, not where it would notice it itself,
+    // and could report LOOP where on its own it would hit the limit first
+    if (final->reason == SWEEP_LIMIT || final->reason == SWEEP_LOOP) {
+        return;
+    }
+
+    for (i = 0; i < count; ++i) {
+        sweep_converged_t converged;
+        uint32_t suffix = result->output_size - checkpoints[i].output_size;
+
+        converged.state = checkpoints[i].state;
+        converged.snapshot = checkpoints[i].snapshot;
+        converged.final = *final;
+        converged.output_hash = result->output_hash - checkpoints[i].output_hash * mvm_sweep_power(suffix);
+        converged.output_size = suffix;
+        converged.steps = result->steps - checkpoints[i].steps;
+        mvm_sweep_publish(sweep, &converged);
+    }
+}
+
+//
+// Aggregation
+//
+
+static uint64_t mvm_sweep_mix (uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdull;
+    key ^= key >> 33;
+    return key ? key : 1;
+}
+
+static sweep_bucket_t* mvm_sweep_find (sweep_map_t *map, uint64_t key);
+
+// Called from the workers, so failures are reported by the caller of mvm_sweep_run
+static bool mvm_sweep_grow (mvm_context_t *context, sweep_map_t *map) {
+    sweep_map_t grown;
+    uint64_t i;
+
+    grown.capacity = map->capacity ? map->capacity * 2 : 256;
+    grown.count = 0;
+    grown.buckets = (sweep_bucket_t*)mvm_alloc(context, (size_t)grown.capacity * sizeof(sweep_bucket_t));
+    if (!grown.buckets) {
+        return false;
+    }
+
+    for (i = 0; i < map->capacity; ++i) {
+        if (map->buckets[i].key) {
+            *mvm_sweep_find(&grown, map->buckets[i].key) = map->buckets[i];
+            grown.count++;
+        }
+    }
+
+    mvm_free(context, map->buckets);
+    *map = grown;
+    return true;
+}
+
+// Returns the bucket holding key, or the empty bucket where it belongs
+static sweep_bucket_t* mvm_sweep_find (sweep_map_t *map, uint64_t key) {
+    uint64_t slot = key & (map->capacity - 1);
+    while (map->buckets[slot].key && map->buckets[slot].key != key) {
+        slot = (slot + 1) & (map->capacity - 1);
+    }
+    return &map->buckets[slot];
+}
+
+// Adds count runs under key, first is the lowest variant among them
+static bool mvm_sweep_count (mvm_context_t *context, sweep_map_t *map, uint64_t key, uint64_t count, uint64_t first,
+                             const sweep_final_t *final, uint32_t output_size) {
+    sweep_bucket_t *bucket;
+
+    if (2 * (map->count + 1) > map->capacity && !mvm_sweep_grow(context, map)) {
+        return false;
+    }
+
+    bucket = mvm_sweep_find(map, key);
+    if (!bucket->key) {
+        bucket->key = key;
+        bucket->first = first;
+        bucket->final = *final;
+        bucket->output_size = output_size;
+        map->count++;
+    } else if (first < bucket->first) {
+        bucket->first = first;
+    }
+    bucket->count += count;
+    return true;
+}
+
+static uint64_t mvm_sweep_final_key (const sweep_final_t *final) {
+    byte fields[] = { final->reason, final->flags, final->pc, final->a, final->b, final->c, final->d };
+    return mvm_sweep_mix(mvm_sweep_hash(final->memory, fields, sizeof(fields)));
+}
+
+static void mvm_sweep_worker (void *arg) {
+    sweep_worker_t *worker = (sweep_worker_t*)arg;
+    sweep_t *sweep = worker->sweep;
+
+    for (;;) {
+        uint64_t first;
+        uint64_t last;
+        uint64_t variant;
+
+        mvm_mutex_lock(&sweep->lock);
+        first = sweep->next;
+        last = (sweep->variants - first > SWEEP_CHUNK) ? first + SWEEP_CHUNK : sweep->variants;
+        sweep->next = last;
+        mvm_mutex_unlock(&sweep->lock);
+
+        if (first >= last) {
+            return;
+        }
+
+        for (variant = first; variant < last; ++variant) {
+            sweep_result_t result;
+            uint64_t output_key;
+
+            mvm_sweep_execute(sweep, variant, &worker->run, &result, true);
+
+            worker->reasons[result.final.reason]++;
+            worker->steps += result.steps;
+            if (result.converged) {
+                worker->converged++;
+            }
+
+            output_key = mvm_sweep_mix(result.output_hash ^ ((uint64_t)result.output_size << 32));
+            if (!mvm_sweep_count(sweep->context, &worker->states, mvm_sweep_final_key(&result.final), 1, variant, &result.final, 0)
+                || (result.final.reason != SWEEP_LOOP
+                    && !mvm_sweep_count(sweep->context, &worker->outputs, output_key, 1, variant, &result.final, result.output_size))) {
+                worker->failed = true;
+                return;
+            }
+        }
+    }
+}
+
+static bool mvm_sweep_merge (mvm_context_t *context, sweep_map_t *into, const sweep_map_t *from) {
+    uint64_t i;
+    for (i = 0; i < from->capacity; ++i) {
+        const sweep_bucket_t *bucket = &from->buckets[i];
+        if (bucket->key && !mvm_sweep_count(context, into, bucket->key, bucket->count, bucket->first,
+                                            &bucket->final, bucket->output_size)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int mvm_sweep_by_count (const void *left, const void *right) {
+    const sweep_bucket_t *l = (const sweep_bucket_t*)left;
+    const sweep_bucket_t *r = (const sweep_bucket_t*)right;
+    if (l->count != r->count) {
+        return (l->count > r->count) ? -1 : 1;
+    }
+    return (l->first < r->first) ? -1 : (l->first > r->first);
+}
+
+static int mvm_sweep_by_first (const void *left, const void *right) {
+    const sweep_bucket_t *l = (const sweep_bucket_t*)left;
+    const sweep_bucket_t *r = (const sweep_bucket_t*)right;
+    return (l->first < r->first) ? -1 : (l->first > r->first);
+}
+
+// Moves the used buckets to the front and sorts them
+static void mvm_sweep_sort (sweep_map_t *map, int (*compare)(const void*, const void*)) {
+    uint64_t used = 0;
+    uint64_t i;
+    for (i = 0; i < map->capacity; ++i) {
+        if (map->buckets[i].key) {
+            map->buckets[used++] = map->buckets[i];
+        }
+    }
+    qsort(map->buckets, (size_t)used, sizeof(sweep_bucket_t), compare);
+}
+
+static void mvm_sweep_describe (const sweep_t *sweep, uint64_t variant, char *dest, uint32_t size) {
+    byte values[SWEEP_MAX_DIMENSIONS];
+    uint32_t used = 0;
+    uint32_t i;
+
+    dest[0] = 0;
+    mvm_sweep_values(sweep, variant, values);
+    for (i = 0; i < sweep->spec->count; ++i) {
+        uint32_t target = sweep->spec->dimensions[i].target;
+        int n;
+
+        if (target < SWEEP_MEMORY) {
+            n = mvm_print_string(dest + used, size - used, "%s%s=0x%02x", used ? " " : "",
+                s_registers[target], values[i]);
+        } else {
+            n = mvm_print_string(dest + used, size - used, "%s@0x%02x=0x%02x", used ? " " : "",
+                target - SWEEP_MEMORY, values[i]);
+        }
+        if (n < 0 || used + n >= size) {
+            break;
+        }
+        used += n;
+    }
+}
+
+// Escapes captured output so each distinct output prints on one line
+static void mvm_sweep_escape (const char *text, uint32_t size, char *dest, uint32_t capacity) {
+    uint32_t used = 0;
+    uint32_t i;
+
+    for (i = 0; i < size && used + 5 < capacity; ++i) {
+        byte c = (byte)text[i];
+        if (c == '\n') {
+            dest[used++] = '\\';
+            dest[used++] = 'n';
+        } else if (c == '\\' || c == '"') {
+            dest[used++] = '\\';
+            dest[used++] = (char)c;
+        } else if (c >= 0x20 && c < 0x7f) {
+            dest[used++] = (char)c;
+        } else {
+            used += mvm_print_string(dest + used, capacity - used, "\\x%02x", c);
+        }
+    }
+    dest[used] = 0;
+}
+
+static void mvm_sweep_report (sweep_t *sweep, sweep_worker_t *total, uint32_t jobs) {
+    char described[MESSAGE_SZ];
+    char *text;
+    char *escaped;
+    uint64_t shown;
+    uint64_t i;
+
+    mvm_info(sweep->context, "## sweep: %llu variants on %u threads, %llu halted, %llu exceptions, %llu hit the limit, %llu looped, %llu converged, %llu instructions",
+        (unsigned long long)sweep->variants, jobs,
+        (unsigned long long)total->reasons[SWEEP_HALT], (unsigned long long)total->reasons[SWEEP_EXCEPTION],
+        (unsigned long long)total->reasons[SWEEP_LIMIT], (unsigned long long)total->reasons[SWEEP_LOOP],
+        (unsigned long long)total->converged,
+        (unsigned long long)total->steps);
+
+    mvm_sweep_sort(&total->states, mvm_sweep_by_count);
+    shown = (total->states.count < sweep->spec->show) ? total->states.count : sweep->spec->show;
+    mvm_info(sweep->context, "## sweep: %llu distinct final states", (unsigned long long)total->states.count);
+    for (i = 0; i < shown; ++i) {
+        const sweep_bucket_t *bucket = &total->states.buckets[i];
+        const sweep_final_t *final = &bucket->final;
+        mvm_sweep_describe(sweep, bucket->first, described, sizeof(described));
+        if (final->reason == SWEEP_LOOP) {
+            mvm_info(sweep->context, "%10llu  LOOP  first: %s", (unsigned long long)bucket->count, described);
+            continue;
+        }
+        mvm_info(sweep->context, "%10llu  %s PC: 0x%02x, A: 0x%02x, B: 0x%02x, C: 0x%02x, D: 0x%02x, RAM: %08x  first: %s",
+            (unsigned long long)bucket->count, s_reasons[final->reason],
+            final->pc, final->a, final->b, final->c, final->d, (uint32_t)final->memory, described);
+    }
+
+    text = (char*)mvm_alloc(sweep->context, SWEEP_TEXT_SZ);
+    escaped = (char*)mvm_alloc(sweep->context, 4 * SWEEP_TEXT_SZ + 1);
+    if (!text || !escaped) {
+        mvm_error(sweep->context, "mvm_sweep: couldn't allocate output text");
+        mvm_free(sweep->context, text);
+        mvm_free(sweep->context, escaped);
+        return;
+    }
+
+    // Converged runs only know the hash of their output, so the text is recovered by running again
+    mvm_sweep_sort(&total->outputs, mvm_sweep_by_first);
+    shown = (total->outputs.count < sweep->spec->show) ? total->outputs.count : sweep->spec->show;
+    mvm_info(sweep->context, "## sweep: %llu distinct outputs, %llu looped runs left out",
+        (unsigned long long)total->outputs.count, (unsigned long long)total->reasons[SWEEP_LOOP]);
+    for (i = 0; i < shown; ++i) {
+        const sweep_bucket_t *bucket = &total->outputs.buckets[i];
+        sweep_result_t result;
+
+        total->run.text = text;
+        mvm_sweep_execute(sweep, bucket->first, &total->run, &result, false);
+        total->run.text = NULL;
+
+        mvm_sweep_escape(text, total->run.text_size, escaped, 4 * SWEEP_TEXT_SZ + 1);
+        mvm_sweep_describe(sweep, bucket->first, described, sizeof(described));
+        mvm_info(sweep->context, "%10llu  \"%s\"%s  first: %s", (unsigned long long)bucket->count, escaped,
+            (bucket->output_size > SWEEP_TEXT_SZ) ? "..." : "", described);
+    }
+
+    mvm_free(sweep->context, text);
+    mvm_free(sweep->context, escaped);
+}
+
+bool mvm_sweep_run (mvm_context_t *context, const sweep_spec_t *spec, const byte *image) {
+    sweep_t sweep;
+    sweep_worker_t *workers;
+    mvm_thread_t *threads;
+    uint32_t jobs = spec->jobs ? spec->jobs : mvm_cpu_count();
+    uint32_t started;
+    uint32_t i;
+    uint32_t j;
+    bool status = true;
+
+    memset(&sweep, 0, sizeof(sweep));
+    sweep.context = context;
+    sweep.spec = spec;
+    sweep.image = image;
+    sweep.variants = 1;
+
+    for (i = 0; i < spec->count; ++i) {
+        sweep.variants *= spec->dimensions[i].count;
+        if (sweep.variants > ((uint64_t)1 << 40)) {
+            mvm_error(context, "mvm_sweep: too many variants");
+            return false;
+        }
+    }
+
+    sweep.table = (sweep_converged_t*)mvm_alloc(context, SWEEP_TABLE * sizeof(sweep_converged_t));
+    workers = (sweep_worker_t*)mvm_alloc(context, jobs * sizeof(sweep_worker_t));
+    threads = (mvm_thread_t*)mvm_alloc(context, jobs * sizeof(mvm_thread_t));
+    if (!sweep.table || !workers || !threads) {
+        mvm_error(context, "mvm_sweep: couldn't allocate %u workers", jobs);
+        mvm_free(context, sweep.table);
+        mvm_free(context, workers);
+        mvm_free(context, threads);
+        return false;
+    }
+
+    mvm_mutex_init(&sweep.lock);
+    for (i = 0; i < SWEEP_LOCKS; ++i) {
+        mvm_mutex_init(&sweep.locks[i]);
+    }
+
+    for (started = 0; started < jobs; ++started) {
+        workers[started].sweep = &sweep;
+        if (!mvm_thread_start(&threads[started], mvm_sweep_worker, &workers[started])) {
+            mvm_error(context, "mvm_sweep: couldn't start thread %u", started);
+            break;
+        }
+    }
+
+    for (i = 0; i < started; ++i) {
+        mvm_thread_join(&threads[i]);
+    }
+
+    if (started == 0) {
+        status = false;
+    }
+
+    // Fold every worker into the first
+    for (i = 0; i < started; ++i) {
+        if (workers[i].failed) {
+            status = false;
+        }
+        if (i == 0) {
+            continue;
+        }
+        for (j = 0; j < SWEEP_REASONS; ++j) {
+            workers[0].reasons[j] += workers[i].reasons[j];
+        }
+        workers[0].converged += workers[i].converged;
+        workers[0].steps += workers[i].steps;
+        if (!mvm_sweep_merge(context, &workers[0].states, &workers[i].states)
+            || !mvm_sweep_merge(context, &workers[0].outputs, &workers[i].outputs)) {
+            status = false;
+        }
+    }
+
+    if (started > 0 && !status) {
+        mvm_error(context, "mvm_sweep: couldn't allocate the histograms");
+    }
+
+    if (status) {
+        mvm_sweep_report(&sweep, &workers[0], started);
+    }
+
+    for (i = 0; i < jobs; ++i) {
+        mvm_free(context, workers[i].states.buckets);
+        mvm_free(context, workers[i].outputs.buckets);
+    }
+    for (i = 0; i < SWEEP_LOCKS; ++i) {
+        mvm_mutex_destroy(&sweep.locks[i]);
+    }
+    mvm_mutex_destroy(&sweep.lock);
+    mvm_free(context, sweep.table);
+    mvm_free(context, workers);
+    mvm_free(context, threads);
+
+    return status;
+}
@@ -0,0 +1,42 @@
+#ifndef _included_minvm_sweep_h
+#define _included_minvm_sweep_h
+
+//
+// Initial-state sweep
+//
+// Runs one image once for every combination of initial register and memory
+// values given by the -vary options, on a pool of host threads, and reports
+// a histogram of the final states and the first distinct interrupt outputs.
+//
+// Runs that converge on a machine state an earlier run already finished
+// from are not executed further: every run hashes its full state (program
+// counter, flags, registers and memory) at backward jumps, and a completed
+// run publishes the final state, the remaining output and instruction count
+// for each of its checkpoints. States are looked up by their 64 bit hash and
+// only match when the full state is the same. Runs found to loop share
+// nothing and their output isn't counted, so the report doesn't depend on
+// the number of threads or the order runs finish in.
+//
+
+#define SWEEP_MAX_DIMENSIONS    16
+#define SWEEP_MEMORY            4       // Dimension targets 0..3 are registers A..D, then memory words
+
+typedef struct sweep_dimension_t {
+    uint32_t    target;                 // Register index, or SWEEP_MEMORY + address
+    uint32_t    count;
+    byte        values[RAM_SIZE];
+} sweep_dimension_t;
+
+typedef struct sweep_spec_t {
+    sweep_dimension_t dimensions[SWEEP_MAX_DIMENSIONS];
+    uint32_t    count;
+    uint64_t    limit;                  // Instructions per run before giving up
+    uint32_t    jobs;                   // Host threads, 0 for one per processor
+    uint32_t    show;                   // Histogram rows and distinct outputs printed
+} sweep_spec_t;
+
+void        mvm_sweep_init (sweep_spec_t *spec);
+bool        mvm_sweep_parse (mvm_context_t *context, sweep_spec_t *spec, cchar *vary);
+bool        mvm_sweep_run (mvm_context_t *context, const sweep_spec_t *spec, const byte *image);
+
+#endif // _included_minvm_sweep_h
@@ -10,30 +10,46 @@
 
 #include "minvm_defs.h"
 
+// Every access to RAM is a single word load or store, cores in multi-core mode share the code array
+#define readWord(vm, address)           LOAD_WORD(&(vm)->code[address])
+#define writeWord(vm, address, value)   STORE_WORD(&(vm)->code[address], value)
+#define fetchWord(vm)                   readWord(vm, (vm)->pc++) // Reads the word at the program counter and advances past it
+
 static const byte registerMasks[] = { REGA, REGB, REGC, REGD };
 static const byte bitCountLookup[] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 }; // Used to look up the number of one bits in a half-word
-void loadi (virtual_machine_t *vm, byte *registers[], byte destinationRegisterMask);
-void inc (byte *registers[], byte operandRegisterMask);
-void dec (byte *registers[], byte operandRegisterMask);
-void loadr (virtual_machine_t *vm, byte *registers[], byte destinationRegisterMask);
-void add (virtual_machine_t *vm, byte *registers[], byte destinationRegisterMask);
-void sub (virtual_machine_t *vm, byte *registers[], byte destinationRegisterMask);
-void mul (virtual_machine_t *vm, byte *registers[], byte destinationRegisterMask);
-void div (virtual_machine_t *vm, byte *registers[], byte destinationRegisterMask);
-void and (virtual_machine_t *vm, byte *registers[], byte destinationRegisterMask);
-void or (virtual_machine_t *vm, byte *registers[], byte destinationRegisterMask);
-void xor (virtual_machine_t *vm, byte *registers[], byte destinationRegisterMask);
-void rotr (byte *registers[], byte operandRegisterMask);
-void jmpneq (virtual_machine_t *vm, byte *registers[], byte operandRegisterMask);
-void jmpeq (virtual_machine_t *vm, byte *registers[], byte operandRegisterMask);
-void stor (virtual_machine_t *vm, byte *registers[], byte sourceRegisterMask);
-void itr (virtual_machine_t *vm, byte interruptFunctionIndex);
-byte getRelevantRegisters (byte *relevantRegisters[], byte *allRegisters[], byte registerMask);
-unsigned long getLongFromRegisters (byte *registers[], byte operandRegisterMask);
-void storeLongResultInRegisters (unsigned long result, byte *registers[], byte destinationRegisterMask);
-bool isValidSourceRegisterMask (byte sourceRegisterMask, byte numRequiredRegisters);
-void storeByteInEachRegister (byte result, byte *registers[], byte destinationRegisterMask);
-bool allRegistersEqual (byte *relevantRegisters[], byte count);
+static void step (virtual_machine_t *vm, byte *registers[]);
+static void stepVerified (virtual_machine_t *vm, byte *registers[]);
+static void loadi (virtual_machine_t *vm, byte *registers[], byte destinationRegisterMask);
+static void inc (byte *registers[], byte operandRegisterMask);
+static void dec (byte *registers[], byte operandRegisterMask);
+static void loadr (virtual_machine_t *vm, byte *registers[], byte destinationRegisterMask);
+static void add (virtual_machine_t *vm, byte *registers[], byte destinationRegisterMask);
+static void sub (virtual_machine_t *vm, byte *registers[], byte destinationRegisterMask);
+static void mul (virtual_machine_t *vm, byte *registers[], byte destinationRegisterMask);
+static void div (virtual_machine_t *vm, byte *registers[], byte destinationRegisterMask);
+static void and (virtual_machine_t *vm, byte *registers[], byte destinationRegisterMask);
+static void or (virtual_machine_t *vm, byte *registers[], byte destinationRegisterMask);
+static void xor (virtual_machine_t *vm, byte *registers[], byte destinationRegisterMask);
+static void rotr (byte *registers[], byte operandRegisterMask);
+static void jmpneq (virtual_machine_t *vm, byte *registers[], byte operandRegisterMask);
+static void jmpeq (virtual_machine_t *vm, byte *registers[], byte operandRegisterMask);
+static void stor (virtual_machine_t *vm, byte *registers[], byte sourceRegisterMask);
+static void itr (virtual_machine_t *vm, byte interruptFunctionIndex);
+static address_t fetchAddress (virtual_machine_t *vm);
+static void loadrUnchecked (virtual_machine_t *vm, byte *registers[], byte destinationRegisterMask, byte sourceRegisterMask);
+static void addUnchecked (byte *registers[], byte destinationRegisterMask, byte sourceRegisterMask);
+static void subUnchecked (byte *registers[], byte destinationRegisterMask, byte sourceRegisterMask);
+static void mulUnchecked (byte *registers[], byte destinationRegisterMask, byte sourceRegisterMask);
+static void divUnchecked (virtual_machine_t *vm, byte *registers[], byte destinationRegisterMask, byte sourceRegisterMask);
+static void andUnchecked (byte *registers[], byte destinationRegisterMask, byte sourceRegisterMask);
+static void orUnchecked (byte *registers[], byte destinationRegisterMask, byte sourceRegisterMask);
+static void xorUnchecked (byte *registers[], byte destinationRegisterMask, byte sourceRegisterMask);
+static byte getRelevantRegisters (byte *relevantRegisters[], byte *allRegisters[], byte registerMask);
+static unsigned long getLongFromRegisters (byte *registers[], byte operandRegisterMask);
+static void storeLongResultInRegisters (unsigned long result, byte *registers[], byte destinationRegisterMask);
+static bool isValidSourceRegisterMask (byte sourceRegisterMask, byte numRequiredRegisters);
+static void storeByteInEachRegister (byte result, byte *registers[], byte destinationRegisterMask);
+static bool allRegistersEqual (byte *relevantRegisters[], byte count);
 
 // Implement your VM here
 void vm_exec (virtual_machine_t *vm) {
@@ -43,47 +59,149 @@ void vm_exec (virtual_machine_t *vm) {
     registers[2] = &(vm->c);
     registers[3] = &(vm->d);
     while (!(vm->flags & MINVM_HALT)) { // Continue running if the halt flag is not set
-        byte instruction = vm->code[vm->pc++]; // Increments the program counter past the instruction
-        byte opcode = 0xF0 & instruction; // The upper 4 bits of the instruction
-        byte argument = 0x0F & instruction; // The lower 4 bits of the instruction
-        switch (opcode) {
-            case 0x00: // LOADI
-                loadi(vm, registers, argument); break;
-            case 0x10: // INC
-                inc(registers, argument); break;
-            case 0x20: // DEC
-                dec(registers, argument); break;
-            case 0x30: // LOADR
-                loadr(vm, registers, argument); break;
-            case 0x40: // ADD
-                add(vm, registers, argument); break;
-            case 0x50: // SUB
-                sub(vm, registers, argument); break;
-            case 0x60: // MUL
-                mul(vm, registers, argument); break;
-            case 0x70: // DIV
-                div(vm, registers, argument); break;
-            case 0x80: // AND
-                and(vm, registers, argument); break;
-            case 0x90: // OR
-                or(vm, registers, argument); break;
-            case 0xA0: // XOR
-                xor(vm, registers, argument); break;
-            case 0xB0: // ROTR
-                rotr(registers, argument); break;
-            case 0xC0: // JMPNEQ
-                jmpneq(vm, registers, argument); break;
-            case 0xD0: // JMPEQ
-                jmpeq(vm, registers, argument); break;
-            case 0xE0: // STOR
-                stor(vm, registers, argument); break;
-            case 0xF0: // ITR
-                itr(vm, argument); break;
-        }
+        step(vm, registers);
+    }
+}
+
+// Executes a single instruction, used by schedulers that interleave several machines
+void vm_step (virtual_machine_t *vm) {
+    byte *registers[NUM_REGISTERS];
+    registers[0] = &(vm->a);
+    registers[1] = &(vm->b);
+    registers[2] = &(vm->c);
+    registers[3] = &(vm->d);
+    if (!(vm->flags & MINVM_HALT)) {
+        step(vm, registers);
+    }
+}
+
+// Decodes and executes the instruction at the program counter
+static void step (virtual_machine_t *vm, byte *registers[]) {
+    byte instruction = fetchWord(vm); // Increments the program counter past the instruction
+    byte opcode = 0xF0 & instruction; // The upper 4 bits of the instruction
+    byte argument = 0x0F & instruction; // The lower 4 bits of the instruction
+    switch (opcode) {
+        case 0x00: // LOADI
+            loadi(vm, registers, argument); break;
+        case 0x10: // INC
+            inc(registers, argument); break;
+        case 0x20: // DEC
+            dec(registers, argument); break;
+        case 0x30: // LOADR
+            loadr(vm, registers, argument); break;
+        case 0x40: // ADD
+            add(vm, registers, argument); break;
+        case 0x50: // SUB
+            sub(vm, registers, argument); break;
+        case 0x60: // MUL
+            mul(vm, registers, argument); break;
+        case 0x70: // DIV
+            div(vm, registers, argument); break;
+        case 0x80: // AND
+            and(vm, registers, argument); break;
+        case 0x90: // OR
+            or(vm, registers, argument); break;
+        case 0xA0: // XOR
+            xor(vm, registers, argument); break;
+        case 0xB0: // ROTR
+            rotr(registers, argument); break;
+        case 0xC0: // JMPNEQ
+            jmpneq(vm, registers, argument); break;
+        case 0xD0: // JMPEQ
+            jmpeq(vm, registers, argument); break;
+        case 0xE0: // STOR
+            stor(vm, registers, argument); break;
+        case 0xF0: // ITR
+            itr(vm, argument); break;
+    }
+}
+
+// Runs a program that mvm_verify() has proven safe
+// Every reachable source mask is valid and no STOR can overwrite code, so the mask checks are skipped
+void vm_exec_verified (virtual_machine_t *vm) {
+    byte *registers[NUM_REGISTERS];
+    registers[0] = &(vm->a);
+    registers[1] = &(vm->b);
+    registers[2] = &(vm->c);
+    registers[3] = &(vm->d);
+    while (!(vm->flags & MINVM_HALT)) {
+        stepVerified(vm, registers);
+    }
+}
+
+// Executes at most budget instructions and returns how many ran. The engines above don't count
+// instructions, callers that need vm->instructions add this count to it
+uint64_t vm_run (virtual_machine_t *vm, uint64_t budget) {
+    byte *registers[NUM_REGISTERS];
+    uint64_t executed = 0;
+    registers[0] = &(vm->a);
+    registers[1] = &(vm->b);
+    registers[2] = &(vm->c);
+    registers[3] = &(vm->d);
+    while (executed < budget && !(vm->flags & MINVM_HALT)) {
+        step(vm, registers);
+        executed++;
+    }
+    return executed;
+}
+
+// vm_run() for a program that mvm_verify() has proven safe
+uint64_t vm_run_verified (virtual_machine_t *vm, uint64_t budget) {
+    byte *registers[NUM_REGISTERS];
+    uint64_t executed = 0;
+    registers[0] = &(vm->a);
+    registers[1] = &(vm->b);
+    registers[2] = &(vm->c);
+    registers[3] = &(vm->d);
+    while (executed < budget && !(vm->flags & MINVM_HALT)) {
+        stepVerified(vm, registers);
+        executed++;
+    }
+    return executed;
+}
+
+// Decodes and executes the instruction at the program counter, the source masks are known to be valid
+static void stepVerified (virtual_machine_t *vm, byte *registers[]) {
+    byte instruction = fetchWord(vm);
+    byte opcode = 0xF0 & instruction;
+    byte argument = 0x0F & instruction;
+    switch (opcode) {
+        case 0x00: // LOADI
+            loadi(vm, registers, argument); break;
+        case 0x10: // INC
+            inc(registers, argument); break;
+        case 0x20: // DEC
+            dec(registers, argument); break;
+        case 0x30: // LOADR
+            loadrUnchecked(vm, registers, argument, fetchWord(vm)); break;
+        case 0x40: // ADD
+            addUnchecked(registers, argument, fetchWord(vm)); break;
+        case 0x50: // SUB
+            subUnchecked(registers, argument, fetchWord(vm)); break;
+        case 0x60: // MUL
+            mulUnchecked(registers, argument, fetchWord(vm)); break;
+        case 0x70: // DIV
+            divUnchecked(vm, registers, argument, fetchWord(vm)); break;
+        case 0x80: // AND
+            andUnchecked(registers, argument, fetchWord(vm)); break;
+        case 0x90: // OR
+            orUnchecked(registers, argument, fetchWord(vm)); break;
+        case 0xA0: // XOR
+            xorUnchecked(registers, argument, fetchWord(vm)); break;
+        case 0xB0: // ROTR
+            rotr(registers, argument); break;
+        case 0xC0: // JMPNEQ
+            jmpneq(vm, registers, argument); break;
+        case 0xD0: // JMPEQ
+            jmpeq(vm, registers, argument); break;
+        case 0xE0: // STOR
+            stor(vm, registers, argument); break;
+        case 0xF0: // ITR
+            itr(vm, argument); break;
     }
 }
 
-void loadi (virtual_machine_t *vm, byte *registers[], byte destinationRegisterMask) {
+static void loadi (virtual_machine_t *vm, byte *registers[], byte destinationRegisterMask) {
     byte *destinationRegisters[NUM_REGISTERS];
     byte count;
     byte index;
@@ -93,159 +211,112 @@ void loadi (virtual_machine_t *vm, byte *registers[], byte destinationRegisterMa
     }
     count = getRelevantRegisters(destinationRegisters, registers, destinationRegisterMask);
     for (index = 0; index < count; ++index) {
-        *destinationRegisters[index] = vm->code[vm->pc++]; // Write to the destination registers
+        *destinationRegisters[index] = fetchWord(vm); // Write to the destination registers
     }
 }
 
-void inc (byte *registers[], byte operandRegisterMask) {
+static void inc (byte *registers[], byte operandRegisterMask) {
     unsigned long temp = getLongFromRegisters(registers, operandRegisterMask);
     ++temp;
     storeLongResultInRegisters(temp, registers, operandRegisterMask);
 }
 
-void dec (byte *registers[], byte operandRegisterMask) {
+static void dec (byte *registers[], byte operandRegisterMask) {
     unsigned long temp = getLongFromRegisters(registers, operandRegisterMask);
     --temp;
     storeLongResultInRegisters(temp, registers, operandRegisterMask);
 }
 
-void loadr (virtual_machine_t *vm, byte *registers[], byte destinationRegisterMask) {
-    byte sourceRegisterMask = vm->code[vm->pc++];
+static void loadr (virtual_machine_t *vm, byte *registers[], byte destinationRegisterMask) {
+    byte sourceRegisterMask = fetchWord(vm);
     byte countOfDestinationRegisters = bitCountLookup[destinationRegisterMask];
-    byte data[NUM_REGISTERS]; // Temporary storage for data read from the code array
-    byte *sourceRegisters[NUM_REGISTERS];
-    byte *destinationRegisters[NUM_REGISTERS];
-    byte count;
-    byte index;
 
     if (!isValidSourceRegisterMask(sourceRegisterMask, countOfDestinationRegisters)) { // The count of source registers must equal the count of destination registers
         vm->flags = MINVM_EXCEPTION | MINVM_HALT;
         return;
     }
 
-    count = getRelevantRegisters(sourceRegisters, registers, sourceRegisterMask);
-    for (index = 0; index < count; ++index) {
-        data[index] = vm->code[*sourceRegisters[index]]; // Copy values from code to data array
-    }
-
-    count = getRelevantRegisters(destinationRegisters, registers, destinationRegisterMask);
-    for (index = 0; index < count; ++index) {
-        *destinationRegisters[index] = data[index]; // Copy values to destination registers
-    }
+    loadrUnchecked(vm, registers, destinationRegisterMask, sourceRegisterMask);
 }
 
-void add (virtual_machine_t *vm, byte *registers[], byte destinationRegisterMask) {
-    byte sourceRegisterMask = vm->code[vm->pc++];
-    byte *operands[NUM_REGISTERS];
-    unsigned long result;
+static void add (virtual_machine_t *vm, byte *registers[], byte destinationRegisterMask) {
+    byte sourceRegisterMask = fetchWord(vm);
 
     if (!isValidSourceRegisterMask(sourceRegisterMask, 2)) { // The count of source registers must equal 2
         vm->flags = MINVM_EXCEPTION | MINVM_HALT;
         return;
     }
 
-    getRelevantRegisters(operands, registers, sourceRegisterMask); // Gets the two source registers
-    result = (unsigned long)*operands[0] + (unsigned long)*operands[1];
-    storeLongResultInRegisters(result, registers, destinationRegisterMask); // Store the result back to the destination registers
+    addUnchecked(registers, destinationRegisterMask, sourceRegisterMask);
 }
 
-void sub (virtual_machine_t *vm, byte *registers[], byte destinationRegisterMask) {
-    byte sourceRegisterMask = vm->code[vm->pc++];
-    byte *operands[NUM_REGISTERS];
-    unsigned long result;
+static void sub (virtual_machine_t *vm, byte *registers[], byte destinationRegisterMask) {
+    byte sourceRegisterMask = fetchWord(vm);
 
     if (!isValidSourceRegisterMask(sourceRegisterMask, 2)) { // The count of source registers must equal 2
         vm->flags = MINVM_EXCEPTION | MINVM_HALT;
         return;
     }
 
-    getRelevantRegisters(operands, registers, sourceRegisterMask); // Gets the two source registers
-    result = (unsigned long)*operands[0] - (unsigned long)*operands[1];
-    storeLongResultInRegisters(result, registers, destinationRegisterMask); // Store the result back to the destination registers
+    subUnchecked(registers, destinationRegisterMask, sourceRegisterMask);
 }
 
-void mul (virtual_machine_t *vm, byte *registers[], byte destinationRegisterMask) {
-    byte sourceRegisterMask = vm->code[vm->pc++];
-    byte *operands[NUM_REGISTERS];
-    unsigned long result;
+static void mul (virtual_machine_t *vm, byte *registers[], byte destinationRegisterMask) {
+    byte sourceRegisterMask = fetchWord(vm);
 
     if (!isValidSourceRegisterMask(sourceRegisterMask, 2)) { // The count of source registers must equal 2
         vm->flags = MINVM_EXCEPTION | MINVM_HALT;
         return;
     }
 
-    getRelevantRegisters(operands, registers, sourceRegisterMask); // Gets the two source registers
-    result = (unsigned long)*operands[0] * (unsigned long)*operands[1];
-    storeLongResultInRegisters(result, registers, destinationRegisterMask); // Store the result back to the destination registers
+    mulUnchecked(registers, destinationRegisterMask, sourceRegisterMask);
 }
 
-void div (virtual_machine_t *vm, byte *registers[], byte destinationRegisterMask) {
-    byte sourceRegisterMask = vm->code[vm->pc++];
-    byte *operands[NUM_REGISTERS];
-    unsigned long result;
+static void div (virtual_machine_t *vm, byte *registers[], byte destinationRegisterMask) {
+    byte sourceRegisterMask = fetchWord(vm);
 
     if (!isValidSourceRegisterMask(sourceRegisterMask, 2)) { // The count of source registers must equal 2
         vm->flags = MINVM_EXCEPTION | MINVM_HALT;
         return;
     }
 
-    getRelevantRegisters(operands, registers, sourceRegisterMask); // Gets the two source registers
-
-    if (*operands[1] == 0x00) { // Cannot divide by zero
-        vm->flags = MINVM_EXCEPTION | MINVM_HALT;
-        return;
-    }
-
-    result = (unsigned long)*operands[0] / (unsigned long)*operands[1];
-    storeLongResultInRegisters(result, registers, destinationRegisterMask); // Store the result back to the destination registers
+    divUnchecked(vm, registers, destinationRegisterMask, sourceRegisterMask);
 }
 
-void and (virtual_machine_t *vm, byte *registers[], byte destinationRegisterMask) {
-    byte sourceRegisterMask = vm->code[vm->pc++];
-    byte *operands[NUM_REGISTERS];
-    byte result;
+static void and (virtual_machine_t *vm, byte *registers[], byte destinationRegisterMask) {
+    byte sourceRegisterMask = fetchWord(vm);
 
     if (!isValidSourceRegisterMask(sourceRegisterMask, 2)) { // The count of source registers must equal 2
         vm->flags = MINVM_EXCEPTION | MINVM_HALT;
         return;
     }
 
-    getRelevantRegisters(operands, registers, sourceRegisterMask); // Gets the two source registers
-    result = *operands[0] & *operands[1];
-    storeByteInEachRegister(result, registers, destinationRegisterMask);
+    andUnchecked(registers, destinationRegisterMask, sourceRegisterMask);
 }
 
-void or (virtual_machine_t *vm, byte *registers[], byte destinationRegisterMask) {
-    byte sourceRegisterMask = vm->code[vm->pc++];
-    byte *operands[NUM_REGISTERS];
-    byte result;
+static void or (virtual_machine_t *vm, byte *registers[], byte destinationRegisterMask) {
+    byte sourceRegisterMask = fetchWord(vm);
 
     if (!isValidSourceRegisterMask(sourceRegisterMask, 2)) { // The count of source registers must equal 2
         vm->flags = MINVM_EXCEPTION | MINVM_HALT;
         return;
     }
 
-    getRelevantRegisters(operands, registers, sourceRegisterMask); // Gets the two source registers
-    result = *operands[0] | *operands[1];
-    storeByteInEachRegister(result, registers, destinationRegisterMask);
+    orUnchecked(registers, destinationRegisterMask, sourceRegisterMask);
 }
 
-void xor (virtual_machine_t *vm, byte *registers[], byte destinationRegisterMask) {
-    byte sourceRegisterMask = vm->code[vm->pc++];
-    byte *operands[NUM_REGISTERS];
-    byte result;
+static void xor (virtual_machine_t *vm, byte *registers[], byte destinationRegisterMask) {
+    byte sourceRegisterMask = fetchWord(vm);
 
     if (!isValidSourceRegisterMask(sourceRegisterMask, 2)) { // The count of source registers must equal 2
         vm->flags = MINVM_EXCEPTION | MINVM_HALT;
         return;
     }
 
-    getRelevantRegisters(operands, registers, sourceRegisterMask); // Gets the two source registers
-    result = *operands[0] ^ *operands[1];
-    storeByteInEachRegister(result, registers, destinationRegisterMask);
+    xorUnchecked(registers, destinationRegisterMask, sourceRegisterMask);
 }
 
-void rotr (byte *registers[], byte operandRegisterMask) {
+static void rotr (byte *registers[], byte operandRegisterMask) {
     byte *rotatingRegisters[NUM_REGISTERS];
     byte count = getRelevantRegisters(rotatingRegisters, registers, operandRegisterMask);
     byte index;
@@ -258,8 +329,8 @@ void rotr (byte *registers[], byte operandRegisterMask) {
     }
 }
 
-void jmpneq (virtual_machine_t *vm, byte *registers[], byte operandRegisterMask) {
-    byte jumpLocation = vm->code[vm->pc++];
+static void jmpneq (virtual_machine_t *vm, byte *registers[], byte operandRegisterMask) {
+    address_t jumpLocation = fetchAddress(vm);
     byte *relevantRegisters[NUM_REGISTERS];
     byte count = getRelevantRegisters(relevantRegisters, registers, operandRegisterMask);
     if (count == 0) { // Unconditional jump
@@ -275,8 +346,8 @@ void jmpneq (virtual_machine_t *vm, byte *registers[], byte operandRegisterMask)
     }
 }
 
-void jmpeq (virtual_machine_t *vm, byte *registers[], byte operandRegisterMask) {
-    byte jumpLocation = vm->code[vm->pc++];
+static void jmpeq (virtual_machine_t *vm, byte *registers[], byte operandRegisterMask) {
+    address_t jumpLocation = fetchAddress(vm);
     byte *relevantRegisters[NUM_REGISTERS];
     byte count = getRelevantRegisters(relevantRegisters, registers, operandRegisterMask);
     if (count == 0) { // Unconditional jump
@@ -292,24 +363,130 @@ void jmpeq (virtual_machine_t *vm, byte *registers[], byte operandRegisterMask)
     }
 }
 
-void stor (virtual_machine_t *vm, byte *registers[], byte sourceRegisterMask) {
-    byte storeLocation = vm->code[vm->pc++];
+static void stor (virtual_machine_t *vm, byte *registers[], byte sourceRegisterMask) {
+    address_t storeLocation = fetchAddress(vm);
     byte *sourceRegisters[NUM_REGISTERS];
     byte count = getRelevantRegisters(sourceRegisters, registers, sourceRegisterMask);
     byte index;
     for (index = 0; index < count; ++index) {
-        vm->code[storeLocation++] = *sourceRegisters[index]; // Write the contents of the specified registers to the code array
+        writeWord(vm, storeLocation++, *sourceRegisters[index]); // Write the contents of the specified registers to the code array
     }
 }
 
-void itr (virtual_machine_t *vm, byte interruptFunctionIndex) {
+static void itr (virtual_machine_t *vm, byte interruptFunctionIndex) {
     (vm->interrupts[interruptFunctionIndex])(vm); // Calls the interrupt function specified by the index
 }
 
+// Reads the address operand of a jump or STOR, low word first when addresses take two words
+static address_t fetchAddress (virtual_machine_t *vm) {
+#if ADDRESS_WORDS == 1
+    return fetchWord(vm);
+#else
+    address_t address = fetchWord(vm);
+    address |= (address_t)(fetchWord(vm) << WORD_SIZE);
+    return address;
+#endif
+}
+
+// The Unchecked functions execute an instruction whose source mask is already known to be valid
+// They are shared by the checked instructions above and by vm_exec_verified
+
+static void loadrUnchecked (virtual_machine_t *vm, byte *registers[], byte destinationRegisterMask, byte sourceRegisterMask) {
+    byte data[NUM_REGISTERS]; // Temporary storage for data read from the code array
+    byte *sourceRegisters[NUM_REGISTERS];
+    byte *destinationRegisters[NUM_REGISTERS];
+    byte count;
+    byte index;
+#if ADDRESS_WORDS == 1
+    address_t page = 0;
+#else
+    address_t page = (address_t)(fetchWord(vm) << WORD_SIZE); // The word after the source mask selects the page the registers index
+#endif
+
+    count = getRelevantRegisters(sourceRegisters, registers, sourceRegisterMask);
+    for (index = 0; index < count; ++index) {
+        data[index] = readWord(vm, (address_t)(page | *sourceRegisters[index])); // Copy values from code to data array
+    }
+
+    count = getRelevantRegisters(destinationRegisters, registers, destinationRegisterMask);
+    for (index = 0; index < count; ++index) {
+        *destinationRegisters[index] = data[index]; // Copy values to destination registers
+    }
+}
+
+static void addUnchecked (byte *registers[], byte destinationRegisterMask, byte sourceRegisterMask) {
+    byte *operands[NUM_REGISTERS];
+    unsigned long result;
+
+    getRelevantRegisters(operands, registers, sourceRegisterMask); // Gets the two source registers
+    result = (unsigned long)*operands[0] + (unsigned long)*operands[1];
+    storeLongResultInRegisters(result, registers, destinationRegisterMask); // Store the result back to the destination registers
+}
+
+static void subUnchecked (byte *registers[], byte destinationRegisterMask, byte sourceRegisterMask) {
+    byte *operands[NUM_REGISTERS];
+    unsigned long result;
+
+    getRelevantRegisters(operands, registers, sourceRegisterMask); // Gets the two source registers
+    result = (unsigned long)*operands[0] - (unsigned long)*operands[1];
+    storeLongResultInRegisters(result, registers, destinationRegisterMask); // Store the result back to the destination registers
+}
+
+static void mulUnchecked (byte *registers[], byte destinationRegisterMask, byte sourceRegisterMask) {
+    byte *operands[NUM_REGISTERS];
+    unsigned long result;
+
+    getRelevantRegisters(operands, registers, sourceRegisterMask); // Gets the two source registers
+    result = (unsigned long)*operands[0] * (unsigned long)*operands[1];
+    storeLongResultInRegisters(result, registers, destinationRegisterMask); // Store the result back to the destination registers
+}
+
+static void divUnchecked (virtual_machine_t *vm, byte *registers[], byte destinationRegisterMask, byte sourceRegisterMask) {
+    byte *operands[NUM_REGISTERS];
+    unsigned long result;
+
+    getRelevantRegisters(operands, registers, sourceRegisterMask); // Gets the two source registers
+
+    if (*operands[1] == 0x00) { // Cannot divide by zero, this depends on register values so it is never verified
+        vm->flags = MINVM_EXCEPTION | MINVM_HALT;
+        return;
+    }
+
+    result = (unsigned long)*operands[0] / (unsigned long)*operands[1];
+    storeLongResultInRegisters(result, registers, destinationRegisterMask); // Store the result back to the destination registers
+}
+
+static void andUnchecked (byte *registers[], byte destinationRegisterMask, byte sourceRegisterMask) {
+    byte *operands[NUM_REGISTERS];
+    byte result;
+
+    getRelevantRegisters(operands, registers, sourceRegisterMask); // Gets the two source registers
+    result = *operands[0] & *operands[1];
+    storeByteInEachRegister(result, registers, destinationRegisterMask);
+}
+
+static void orUnchecked (byte *registers[], byte destinationRegisterMask, byte sourceRegisterMask) {
+    byte *operands[NUM_REGISTERS];
+    byte result;
+
+    getRelevantRegisters(operands, registers, sourceRegisterMask); // Gets the two source registers
+    result = *operands[0] | *operands[1];
+    storeByteInEachRegister(result, registers, destinationRegisterMask);
+}
+
+static void xorUnchecked (byte *registers[], byte destinationRegisterMask, byte sourceRegisterMask) {
+    byte *operands[NUM_REGISTERS];
+    byte result;
+
+    getRelevantRegisters(operands, registers, sourceRegisterMask); // Gets the two source registers
+    result = *operands[0] ^ *operands[1];
+    storeByteInEachRegister(result, registers, destinationRegisterMask);
+}
+
 // Populates the relevantRegisters array with pointers to the registers specified in registerMask
 // Returns the count of relevant registers
 // Proceeds from register A to register D
-byte getRelevantRegisters(byte *relevantRegisters[], byte *allRegisters[], byte registerMask) {
+static byte getRelevantRegisters(byte *relevantRegisters[], byte *allRegisters[], byte registerMask) {
     byte index;
     byte count = 0;
     for (index = 0; index < NUM_REGISTERS; ++index) {
@@ -321,7 +498,7 @@ byte getRelevantRegisters(byte *relevantRegisters[], byte *allRegisters[], byte
 }
 
 // Concatenates values in the specified registers into a single unsigned long
-unsigned long getLongFromRegisters(byte *registers[], byte operandRegisterMask) {
+static unsigned long getLongFromRegisters(byte *registers[], byte operandRegisterMask) {
     byte *sourceRegisters[NUM_REGISTERS];
     unsigned long result = 0;
     byte count = getRelevantRegisters(sourceRegisters, registers, operandRegisterMask);
@@ -333,7 +510,7 @@ unsigned long getLongFromRegisters(byte *registers[], byte operandRegisterMask)
 }
 
 // Breaks the long result back into 8 byte pieces and stores them in the registers specified in destinationRegisterMask
-void storeLongResultInRegisters(unsigned long result, byte *registers[], byte destinationRegisterMask) {
+static void storeLongResultInRegisters(unsigned long result, byte *registers[], byte destinationRegisterMask) {
     byte *destinationRegisters[NUM_REGISTERS];
     byte count = getRelevantRegisters(destinationRegisters, registers, destinationRegisterMask);
     byte index;
@@ -344,7 +521,7 @@ void storeLongResultInRegisters(unsigned long result, byte *registers[], byte de
 }
 
 // Checks that a mask has a 0 in the upper byte and encodes a number of registers exactly equal to numRequiredRegisters
-bool isValidSourceRegisterMask (byte sourceRegisterMask, byte numRequiredRegisters) {
+static bool isValidSourceRegisterMask (byte sourceRegisterMask, byte numRequiredRegisters) {
     if (sourceRegisterMask & 0xF0) { // Invalid if the upper byte is not 0
         return false;
     }
@@ -352,7 +529,7 @@ bool isValidSourceRegisterMask (byte sourceRegisterMask, byte numRequiredRegiste
 }
 
 // Stores the result byte into each register specified in destinationRegisterMask
-void storeByteInEachRegister (byte result, byte *registers[], byte destinationRegisterMask) {
+static void storeByteInEachRegister (byte result, byte *registers[], byte destinationRegisterMask) {
     byte *destinationRegisters[NUM_REGISTERS];
     byte count = getRelevantRegisters(destinationRegisters, registers, destinationRegisterMask);
     byte index;
@@ -362,7 +539,7 @@ void storeByteInEachRegister (byte result, byte *registers[], byte destinationRe
 }
 
 // Checks to see if all values in relevantRegisters are equal
-bool allRegistersEqual (byte *relevantRegisters[], byte count) {
+static bool allRegistersEqual (byte *relevantRegisters[], byte count) {
     byte index;
     for (index = 1; index < count; index++) {
         if (*relevantRegisters[0] != *relevantRegisters[index]) {
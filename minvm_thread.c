@@ -0,0 +1,164 @@
+#include <stdlib.h>
+
+#include "minvm_defs.h"
+#include "minvm_thread.h"
+
+#ifndef BUILD_WINDOWS
+#include <unistd.h>
+#include <sched.h>
+#endif
+
+// Heap allocated so the caller's arguments may go out of scope before the thread runs
+typedef struct thread_start_t {
+    thread_function_t   function;
+    void                *arg;
+} thread_start_t;
+
+#ifdef BUILD_WINDOWS
+
+static DWORD WINAPI mvm_thread_main (LPVOID param) {
+    thread_start_t start = *(thread_start_t*)param;
+    free(param);
+    start.function(start.arg);
+    return 0;
+}
+
+bool mvm_thread_start (mvm_thread_t *thread, thread_function_t function, void *arg) {
+    thread_start_t *start = (thread_start_t*)malloc(sizeof(thread_start_t));
+    if (!start) {
+        return false;
+    }
+    start->function = function;
+    start->arg = arg;
+
+    *thread = CreateThread(NULL, 0, mvm_thread_main, start, 0, NULL);
+    if (*thread == NULL) {
+        free(start);
+        return false;
+    }
+    return true;
+}
+
+void mvm_thread_join (mvm_thread_t *thread) {
+    WaitForSingleObject(*thread, INFINITE);
+    CloseHandle(*thread);
+}
+
+uint32_t mvm_cpu_count () {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+}
+
+void mvm_thread_yield () {
+    SwitchToThread();
+}
+
+uint32_t mvm_atomic_load (volatile uint32_t *value) {
+    return (uint32_t)InterlockedCompareExchange((volatile LONG*)value, 0, 0);
+}
+
+void mvm_atomic_store (volatile uint32_t *value, uint32_t next) {
+    InterlockedExchange((volatile LONG*)value, (LONG)next);
+}
+
+void mvm_atomic_increment (volatile uint32_t *value) {
+    InterlockedIncrement((volatile LONG*)value);
+}
+
+uint32_t mvm_atomic_add (volatile uint32_t *value, uint32_t delta) {
+    return (uint32_t)InterlockedExchangeAdd((volatile LONG*)value, (LONG)delta) + delta;
+}
+
+bool mvm_atomic_compare_exchange (volatile uint32_t *value, uint32_t expected, uint32_t next) {
+    return (uint32_t)InterlockedCompareExchange((volatile LONG*)value, (LONG)next, (LONG)expected) == expected;
+}
+
+void mvm_atomic_fence () {
+    MemoryBarrier();
+}
+
+void mvm_mutex_init (mvm_mutex_t *mutex)        { InitializeCriticalSection(mutex); }
+void mvm_mutex_destroy (mvm_mutex_t *mutex)     { DeleteCriticalSection(mutex); }
+void mvm_mutex_lock (mvm_mutex_t *mutex)        { EnterCriticalSection(mutex); }
+void mvm_mutex_unlock (mvm_mutex_t *mutex)      { LeaveCriticalSection(mutex); }
+
+void mvm_cond_init (mvm_cond_t *cond)           { InitializeConditionVariable(cond); }
+void mvm_cond_destroy (mvm_cond_t *cond)        { UNREF(cond); }
+void mvm_cond_wait (mvm_cond_t *cond, mvm_mutex_t *mutex) { SleepConditionVariableCS(cond, mutex, INFINITE); }
+void mvm_cond_signal (mvm_cond_t *cond)         { WakeConditionVariable(cond); }
+void mvm_cond_broadcast (mvm_cond_t *cond)      { WakeAllConditionVariable(cond); }
+
+#else
+
+static void* mvm_thread_main (void *param) {
+    thread_start_t start = *(thread_start_t*)param;
+    free(param);
+    start.function(start.arg);
+    return NULL;
+}
+
+bool mvm_thread_start (mvm_thread_t *thread, thread_function_t function, void *arg) {
+    thread_start_t *start = (thread_start_t*)malloc(sizeof(thread_start_t));
+    if (!start) {
+        return false;
+    }
+    start->function = function;
+    start->arg = arg;
+
+    if (0 != pthread_create(thread, NULL, mvm_thread_main, start)) {
+        free(start);
+        return false;
+    }
+    return true;
+}
+
+void mvm_thread_join (mvm_thread_t *thread) {
+    pthread_join(*thread, NULL);
+}
+
+uint32_t mvm_cpu_count () {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return (count > 0) ? (uint32_t)count : 1;
+}
+
+void mvm_thread_yield () {
+    sched_yield();
+}
+
+uint32_t mvm_atomic_load (volatile uint32_t *value) {
+    return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+}
+
+void mvm_atomic_store (volatile uint32_t *value, uint32_t next) {
+    __atomic_store_n(value, next, __ATOMIC_RELEASE);
+}
+
+void mvm_atomic_increment (volatile uint32_t *value) {
+    __atomic_add_fetch(value, 1, __ATOMIC_ACQ_REL);
+}
+
+uint32_t mvm_atomic_add (volatile uint32_t *value, uint32_t delta) {
+    return __atomic_add_fetch(value, delta, __ATOMIC_ACQ_REL);
+}
+
+bool mvm_atomic_compare_exchange (volatile uint32_t *value, uint32_t expected, uint32_t next) {
+    return __atomic_compare_exchange_n(value, &expected, next, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+void mvm_atomic_fence () {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+void mvm_mutex_init (mvm_mutex_t *mutex)        { pthread_mutex_init(mutex, NULL); }
+void mvm_mutex_destroy (mvm_mutex_t *mutex)     { pthread_mutex_destroy(mutex); }
+void mvm_mutex_lock (mvm_mutex_t *mutex)        { pthread_mutex_lock(mutex); }
+void mvm_mutex_unlock (mvm_mutex_t *mutex)      { pthread_mutex_unlock(mutex); }
+
+void mvm_cond_init (mvm_cond_t *cond)           { pthread_cond_init(cond, NULL); }
+void mvm_cond_destroy (mvm_cond_t *cond)        { pthread_cond_destroy(cond); }
+void mvm_cond_wait (mvm_cond_t *cond, mvm_mutex_t *mutex) { pthread_cond_wait(cond, mutex); }
+void mvm_cond_signal (mvm_cond_t *cond)         { pthread_cond_signal(cond); }
+void mvm_cond_broadcast (mvm_cond_t *cond)      { pthread_cond_broadcast(cond); }
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef _included_minvm_thread_h
+#define _included_minvm_thread_h
+
+//
+// Minimal portable threads, pthreads or Win32 when BUILD_WINDOWS is set
+//
+
+#ifdef BUILD_WINDOWS
+#include <windows.h>
+typedef HANDLE              mvm_thread_t;
+typedef CRITICAL_SECTION    mvm_mutex_t;
+typedef CONDITION_VARIABLE  mvm_cond_t;
+#else
+#include <pthread.h>
+typedef pthread_t           mvm_thread_t;
+typedef pthread_mutex_t     mvm_mutex_t;
+typedef pthread_cond_t      mvm_cond_t;
+#endif
+
+typedef void (*thread_function_t)(void *arg);
+
+bool        mvm_thread_start (mvm_thread_t *thread, thread_function_t function, void *arg);
+void        mvm_thread_join (mvm_thread_t *thread);
+uint32_t    mvm_cpu_count ();
+void        mvm_thread_yield ();
+
+// Single word atomics, loads acquire and stores release
+uint32_t    mvm_atomic_load (volatile uint32_t *value);
+void        mvm_atomic_store (volatile uint32_t *value, uint32_t next);
+void        mvm_atomic_increment (volatile uint32_t *value);
+uint32_t    mvm_atomic_add (volatile uint32_t *value, uint32_t delta);   // Returns the new value
+bool        mvm_atomic_compare_exchange (volatile uint32_t *value, uint32_t expected, uint32_t next);
+void        mvm_atomic_fence ();                                         // Orders earlier stores before later loads
+
+void        mvm_mutex_init (mvm_mutex_t *mutex);
+void        mvm_mutex_destroy (mvm_mutex_t *mutex);
+void        mvm_mutex_lock (mvm_mutex_t *mutex);
+void        mvm_mutex_unlock (mvm_mutex_t *mutex);
+
+void        mvm_cond_init (mvm_cond_t *cond);
+void        mvm_cond_destroy (mvm_cond_t *cond);
+void        mvm_cond_wait (mvm_cond_t *cond, mvm_mutex_t *mutex);
+void        mvm_cond_signal (mvm_cond_t *cond);
+void        mvm_cond_broadcast (mvm_cond_t *cond);
+
+#endif // _included_minvm_thread_h
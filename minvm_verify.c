@@ -0,0 +1,57 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "minvm_defs.h"
+#include "minvm_int.h"
+#include "minvm_verify.h"
+
+static bool mvm_verify_fail (verify_report_t *report, address_t pc, cchar *fmt, ...) {
+    va_list ap;
+
+    va_start(ap, fmt);
+    mvm_vprint_string(report->reason, sizeof(report->reason), fmt, ap);
+    va_end(ap);
+
+    report->safe = false;
+    report->pc = pc;
+    return false;
+}
+
+bool mvm_verify (const byte *code, verify_report_t *report) {
+    uint32_t pc;
+
+    memset(report, 0, sizeof(*report));
+    mvm_build_cfg(code, &report->cfg);
+
+    for (pc = 0; pc < RAM_SIZE; ++pc) {
+        instruction_t ins;
+        uint32_t index;
+
+        if (!(report->cfg.flags[pc] & CFG_ENTRY)) {
+            continue;
+        }
+
+        mvm_decode(code, (address_t)pc, &ins);
+
+        if (mvm_instruction_traps(&ins)) {
+            return mvm_verify_fail(report, ins.pc, "%s at 0x%02x: invalid source mask 0x%02x",
+                mvm_opcode_name(ins.opcode), ins.pc, ins.operand);
+        }
+
+        if (ins.opcode != 0xE0) { // STOR
+            continue;
+        }
+
+        for (index = 0; index < mvm_count_bits(ins.argument); ++index) {
+            address_t target = (address_t)(ins.operand + index);
+            if (report->cfg.flags[target] & CFG_CODE) {
+                return mvm_verify_fail(report, ins.pc, "STOR at 0x%02x: writes code at 0x%02x",
+                    ins.pc, target);
+            }
+        }
+    }
+
+    report->safe = true;
+    return true;
+}
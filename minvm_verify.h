@@ -0,0 +1,26 @@
+#ifndef _included_minvm_verify_h
+#define _included_minvm_verify_h
+
+#include "minvm_cfg.h"
+
+//
+// Load-time verification of a RAM image
+//
+// A program is proven safe when every reachable LOADR and ALU instruction has a
+// valid source mask and no reachable STOR can write a word that is decoded as
+// code. Such a program can never change its own instructions, so the checks
+// made at decode time by vm_exec() always pass and vm_exec_verified() may run it.
+//
+// Interrupt handlers are trusted not to modify memory.
+//
+
+typedef struct verify_report_t {
+    bool        safe;                   // Program was proven safe
+    address_t   pc;                     // Instruction that failed verification
+    char        reason[MESSAGE_SZ];     // Why verification failed
+    cfg_t       cfg;                    // Reachable instructions
+} verify_report_t;
+
+bool        mvm_verify (const byte *code, verify_report_t *report);
+
+#endif // _included_minvm_verify_h
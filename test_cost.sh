@@ -0,0 +1,30 @@
+#!/bin/sh
+#
+# Checks the static instruction estimates of a batch. A loop counter is
+# looked up along the path control takes into the loop, and a loop entered
+# from two paths falls back to -history. Run by make check.
+#
+
+vm=$(pwd)/vm
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+fail() {
+    echo "test_cost: $*"
+    exit 1
+}
+
+cost() {
+    "$vm" -jobs 1 "$@" > "$work/cost.txt" || fail "vm -jobs 1 $* failed"
+    grep '^## cost' "$work/cost.txt"
+}
+
+# A jumps over the LOADI that sets A to 9, the loop runs 3 times
+[ "$(cost testFiles/cost_chain.bin)" = "## cost: estimated 11 (static), actual 9" ] || fail "cost_chain.bin: $(cost testFiles/cost_chain.bin)"
+
+# A is 3 or 5 on the way into the loop
+[ "$(cost testFiles/cost_join.bin)" = "## cost: estimated 36 (guessed), actual 9" ] || fail "cost_join.bin: $(cost testFiles/cost_join.bin)"
+"$vm" -results "$work/history.jsonl" testFiles/cost_join.bin > /dev/null || fail "vm -results failed"
+[ "$(cost -history "$work/history.jsonl" testFiles/cost_join.bin)" = "## cost: estimated 9 (history), actual 9" ] || fail "cost_join.bin didn't use -history"
+
+echo "test_cost: estimates follow the path into each loop"
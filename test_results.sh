@@ -0,0 +1,95 @@
+#!/bin/sh
+#
+# Checks -results against testFiles/results_expected.jsonl, with and without
+# -memo and in a batch, then writes the same runs as binary records and decodes every field
+# at the offset documented in minvm_results.h. Run by make check.
+#
+
+vm=$(pwd)/vm
+expected=$(pwd)/testFiles/results_expected.jsonl
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+# The last name needs a tab, quotes and a backslash escaped
+escaped=$(printf 'say\t"hi"\\.bin')
+cp samples/loop.bin samples/eight_queens.bin testFiles/x7_DIVbyZero.bin testFiles/xE_STOR.bin "$work"
+cp testFiles/xF_ITR.bin "$work/$escaped"
+cd "$work" || exit 1
+set -- loop.bin eight_queens.bin x7_DIVbyZero.bin xE_STOR.bin "$escaped"
+
+fail() {
+    echo "test_results: $*"
+    exit 1
+}
+
+"$vm" -results results.jsonl "$@" > /dev/null || fail "vm -results failed"
+cmp -s results.jsonl "$expected" || fail "JSONL records differ from testFiles/results_expected.jsonl"
+
+# Memo runs skip cached blocks but must count the same instructions, they never use the verified engine
+"$vm" -memo -results memo.jsonl "$@" > /dev/null || fail "vm -memo -results failed"
+sed 's/"verified":true/"verified":false/' "$expected" > memo_expected.jsonl
+cmp -s memo.jsonl memo_expected.jsonl || fail "-memo records differ from testFiles/results_expected.jsonl"
+
+# A batch writes the same records in the order given and keeps its memo lines off stdout
+"$vm" -memo -results memo.jsonl "$@" > sequential.txt
+"$vm" -jobs 2 -memo -results batch.jsonl "$@" > batch.txt || fail "vm -jobs -memo -results failed"
+cmp -s batch.jsonl memo_expected.jsonl || fail "-jobs records differ from testFiles/results_expected.jsonl"
+cmp -s batch.txt sequential.txt || fail "-jobs stdout differs from a sequential run"
+grep -q '^## ' batch.txt && fail "-jobs -results printed ## lines"
+
+"$vm" -results results.bin -format binary "$@" > /dev/null || fail "vm -results -format binary failed"
+[ $(wc -c < results.bin) -eq $((96 * $#)) ] || fail "expected $# records of 96 bytes"
+
+# Little endian unsigned field of size bytes at offset in the current record
+field() {
+    value=0
+    shift_by=0
+    for b in $(od -A n -t u1 -j $((record + $1)) -N $2 results.bin); do
+        value=$((value + (b << shift_by)))
+        shift_by=$((shift_by + 8))
+    done
+    echo $value
+}
+
+record=0
+line=1
+for name in "$@"; do
+    stored=$(dd if=results.bin bs=1 skip=$record count=64 2> /dev/null | tr -d '\000')
+    [ "$stored" = "$name" ] || fail "record $line: name '$stored' != '$name'"
+    [ $(field 89 7) -eq 0 ] || fail "record $line: padding isn't zero"
+
+    reason=halt
+    [ $(field 83 1) -eq 1 ] && reason=exception
+    verified=false
+    [ $(field 88 1) -eq 1 ] && verified=true
+    decoded="\"reason\":\"$reason\",\"pc\":$(field 80 2),\"flags\":$(field 82 1),\"a\":$(field 84 1),\"b\":$(field 85 1),\"c\":$(field 86 1),\"d\":$(field 87 1),\"instructions\":$(field 64 8),\"output_size\":$(field 72 8),\"verified\":$verified}"
+
+    json=$(sed -n "${line}p" "$expected" | sed -E 's/^\{"name":"([^"\\]|\\.)*",//')
+    [ "$decoded" = "$json" ] || fail "record $line: binary $decoded != JSONL $json"
+
+    record=$((record + 96))
+    line=$((line + 1))
+done
+
+# Names too long for a record keep whole UTF-8 characters and end in '#' and a hash of the full
+# name. Here the two byte e acute would straddle the 46 bytes a binary record keeps before the hash
+prefix=$(printf '%045d' 0 | tr 0 a)
+acute=$(printf '\303\251')
+cp loop.bin "$prefix$acute one of two long names.bin"
+cp loop.bin "$prefix$acute two of two long names.bin"
+"$vm" -results long.bin -format binary "$prefix$acute one of two long names.bin" "$prefix$acute two of two long names.bin" > /dev/null || fail "vm -results with long names failed"
+one=$(dd if=long.bin bs=1 count=64 2> /dev/null | tr -d '\000')
+two=$(dd if=long.bin bs=1 skip=96 count=64 2> /dev/null | tr -d '\000')
+case "$one" in "$prefix#"????????????????) ;; *) fail "long binary name stored as '$one'" ;; esac
+[ "$one" != "$two" ] || fail "two long names share the binary record name '$one'"
+
+# JSONL names keep 1023 bytes
+deep=$(printf '%0200d' 0 | tr 0 d)
+mkdir -p "$deep/$deep/$deep/$deep/$deep/$deep"
+cp loop.bin "$deep/$deep/$deep/$deep/$deep/$deep/$acute.bin"
+"$vm" -results long.jsonl "$deep/$deep/$deep/$deep/$deep/$deep/$acute.bin" > /dev/null || fail "vm -results with a long path failed"
+stored=$(sed -E 's/^\{"name":"([^"]*)".*/\1/' long.jsonl)
+[ ${#stored} -le 1023 ] || fail "JSONL name of ${#stored} bytes"
+case "$stored" in "$deep/$deep/$deep/$deep/$deep/"*"#"????????????????) ;; *) fail "long JSONL name stored as '$stored'" ;; esac
+
+echo "test_results: $# records match in JSONL, memo, batch and binary, long names are hashed"
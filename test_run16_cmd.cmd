@@ -0,0 +1,3 @@
+@echo off
+REM run all wide geometry test binaries with the local vm16
+for /r %%i in (testFiles16\*.bin) do vm16 %%i
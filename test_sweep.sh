@@ -0,0 +1,30 @@
+#!/bin/sh
+#
+# Checks that a sweep reports the same histograms on one thread and on
+# several. Run by make check.
+#
+
+vm=$(pwd)/vm
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+fail() {
+    echo "test_sweep: $*"
+    exit 1
+}
+
+# Odd values of a loop forever printing, even ones halt, and both converge on the same states across
+# variants, so runs take results from other threads. The first two lines give the thread count and
+# how many runs converged, which depend on the schedule
+sweep() {
+    "$vm" -vary a=0-255 -vary c=0-15 -jobs $1 -show 4 testFiles/sweep_loop.bin > "$work/sweep.txt" || fail "-jobs $1 failed"
+    tail -n +3 "$work/sweep.txt"
+}
+
+sweep 1 > "$work/single.txt"
+for jobs in 2 4 8 8 8; do
+    sweep $jobs > "$work/multi.txt"
+    cmp -s "$work/single.txt" "$work/multi.txt" || fail "-jobs $jobs histograms differ from -jobs 1"
+done
+
+echo "test_sweep: histograms match on 1 to 8 threads"